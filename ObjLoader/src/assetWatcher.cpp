@@ -0,0 +1,366 @@
+#include "assetWatcher.hpp"
+
+#include <algorithm>
+#include <climits>
+#include <iostream>
+#include <new>
+
+#include "threadPool.hpp"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// Writes, saves that replace the file and files that appear or go away all count as a change
+#ifdef __linux__
+const uint32_t watch_mask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO;
+#endif
+
+// Absolute form of a path, the one events are matched against
+std::string watched_path(const std::filesystem::path& path)
+{
+	std::error_code error;
+	std::filesystem::path absolute = std::filesystem::absolute(path, error);
+	return (error ? path : absolute).lexically_normal().string();
+}
+
+WatchedAsset::WatchedAsset(const std::string& path, bool indexed, const LoadOptions& options)
+	: m_path(path), m_indexed(indexed), m_options(options), m_context(options.memory)
+{
+	// The caller's strings may be gone before a reload starts
+	if (options.cache_path)
+	{
+		m_cache_path = options.cache_path;
+		m_options.cache_path = m_cache_path.c_str();
+	}
+	m_options.progress = &m_progress;
+	m_options.incremental = true;
+	m_files.push_back({ watched_path(path) });
+}
+
+AssetWatcher::AssetWatcher(const WatchOptions& options) : m_options(options)
+{
+#ifdef __linux__
+	// Without the eventfd only a poll timeout wakes the thread, which inotify alone never gives
+	m_wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+	if (!options.force_polling && m_wake >= 0)
+		m_inotify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (!options.force_polling && m_inotify < 0)
+		std::cout << "ERROR :: inotify is not available, polling watched files instead" << std::endl;
+#endif
+	m_thread = std::thread(&AssetWatcher::run, this);
+}
+
+AssetWatcher::~AssetWatcher()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+		for (auto& asset : m_assets)
+			asset->m_progress.cancel = true;
+	}
+	wake();
+	m_thread.join();
+
+	// A reload holds the watcher until it is done with it
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [&] { return m_reloads == 0; });
+	}
+#ifdef __linux__
+	if (m_inotify >= 0)
+		close(m_inotify);
+	if (m_wake >= 0)
+		close(m_wake);
+#endif
+}
+
+std::shared_ptr<WatchedAsset> AssetWatcher::watch(const char* path, bool indexed, const LoadOptions& options)
+{
+	std::shared_ptr<WatchedAsset> asset(new WatchedAsset(path, indexed, options));
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_assets.push_back(asset);
+		// Watched before the load starts, so a change while it runs is not missed
+		if (m_inotify >= 0)
+			sync_directories();
+		else
+			poll_files(Clock::now());
+		start_reload(asset);
+	}
+	wake();
+	return asset;
+}
+
+void AssetWatcher::unwatch(const std::shared_ptr<WatchedAsset>& asset)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		auto found = std::find(m_assets.begin(), m_assets.end(), asset);
+		if (found == m_assets.end())
+			return;
+		m_assets.erase(found);
+		asset->m_changed = false;
+		if (asset->m_loading)
+			asset->m_progress.cancel = true;
+		if (m_inotify >= 0)
+			sync_directories();
+	}
+	wake();
+}
+
+void AssetWatcher::run()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	Clock::time_point next_poll = Clock::now();
+	while (!m_stop)
+	{
+		Clock::time_point now = Clock::now();
+		if (m_sync_directories)
+			sync_directories();
+		if (m_inotify < 0 && now >= next_poll)
+		{
+			poll_files(now);
+			next_poll = now + m_options.poll_interval;
+		}
+
+		// A change waits out the debounce, unless the file keeps changing past max_delay
+		// An asset that changes while it reloads loads again once that reload is done
+		Clock::time_point deadline = m_inotify < 0 ? next_poll : Clock::time_point::max();
+		for (auto& asset : m_assets)
+		{
+			if (!asset->m_changed || asset->m_loading)
+				continue;
+			Clock::time_point due = std::min(asset->m_last_change + m_options.debounce, asset->m_first_change + m_options.max_delay);
+			if (due <= now)
+				start_reload(asset);
+			else
+				deadline = std::min(deadline, due);
+		}
+		wait(lock, deadline);
+	}
+}
+
+#ifdef __linux__
+
+void AssetWatcher::wait(std::unique_lock<std::mutex>& lock, Clock::time_point deadline)
+{
+	int timeout = -1;
+	if (deadline != Clock::time_point::max())
+	{
+		auto remaining = std::chrono::ceil<std::chrono::milliseconds>(deadline - Clock::now()).count();
+		timeout = static_cast<int>(std::clamp<decltype(remaining)>(remaining, 0, INT_MAX));
+	}
+	lock.unlock();
+
+	pollfd fds[2] = { { m_wake, POLLIN, 0 }, { m_inotify, POLLIN, 0 } };
+	int ready = poll(fds, m_inotify >= 0 ? 2 : 1, timeout);
+	uint64_t wakes;
+	if (ready > 0 && (fds[0].revents & POLLIN))
+		while (read(m_wake, &wakes, sizeof(wakes)) > 0) {}
+
+	alignas(inotify_event) char buffer[16384];
+	ssize_t length = 0;
+	if (ready > 0 && m_inotify >= 0 && (fds[1].revents & POLLIN))
+		length = read(m_inotify, buffer, sizeof(buffer));
+
+	lock.lock();
+	Clock::time_point now = Clock::now();
+	for (ssize_t offset = 0; offset < length;)
+	{
+		const inotify_event* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+		offset += sizeof(inotify_event) + event->len;
+		if (event->mask & IN_Q_OVERFLOW)
+		{
+			// Events were lost, any file may have changed
+			for (auto& asset : m_assets)
+				for (const auto& file : asset->m_files)
+					mark_changed(file.path, now);
+			continue;
+		}
+		auto directory = m_directories.find(event->wd);
+		if (directory == m_directories.end())
+			continue;
+		if (event->mask & IN_IGNORED)
+		{
+			// The directory went away, it is watched again when it holds a file after the next reload
+			m_directories.erase(directory);
+			continue;
+		}
+		if (event->len)
+			mark_changed((std::filesystem::path(directory->second) / event->name).string(), now);
+	}
+}
+
+void AssetWatcher::wake()
+{
+	// A failed write means the counter is full, which wakes the thread all the same
+	uint64_t one = 1;
+	[[maybe_unused]] ssize_t written = write(m_wake, &one, sizeof(one));
+}
+
+#else
+
+void AssetWatcher::wait(std::unique_lock<std::mutex>& lock, Clock::time_point deadline)
+{
+	m_woken.wait_until(lock, deadline, [&] { return m_wake_pending; });
+	m_wake_pending = false;
+}
+
+void AssetWatcher::wake()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_wake_pending = true;
+	}
+	m_woken.notify_one();
+}
+
+#endif
+
+void AssetWatcher::mark_changed(const std::string& path, Clock::time_point now)
+{
+	for (auto& asset : m_assets)
+	{
+		bool watched = std::any_of(asset->m_files.begin(), asset->m_files.end(), [&](const WatchedAsset::File& file) { return file.path == path; });
+		if (!watched)
+			continue;
+		if (!asset->m_changed)
+			asset->m_first_change = now;
+		asset->m_changed = true;
+		asset->m_last_change = now;
+	}
+}
+
+void AssetWatcher::poll_files(Clock::time_point now)
+{
+	for (auto& asset : m_assets)
+		for (auto& file : asset->m_files)
+		{
+			std::error_code error;
+			std::filesystem::file_time_type time = std::filesystem::last_write_time(file.path, error);
+			bool exists = !error;
+			std::uintmax_t size = exists ? std::filesystem::file_size(file.path, error) : 0;
+			// The first check only takes the state the load started from
+			bool changed = file.checked && (exists != file.exists || time != file.time || size != file.size);
+			file.time = time;
+			file.size = size;
+			file.exists = exists;
+			file.checked = true;
+			if (changed)
+				mark_changed(file.path, now);
+		}
+}
+
+#ifdef __linux__
+
+void AssetWatcher::sync_directories()
+{
+	m_sync_directories = false;
+	std::vector<std::string> directories;
+	for (auto& asset : m_assets)
+		for (const auto& file : asset->m_files)
+		{
+			std::string directory = std::filesystem::path(file.path).parent_path().string();
+			if (std::find(directories.begin(), directories.end(), directory) == directories.end())
+				directories.push_back(directory);
+		}
+
+	for (auto it = m_directories.begin(); it != m_directories.end();)
+	{
+		if (std::find(directories.begin(), directories.end(), it->second) == directories.end())
+		{
+			inotify_rm_watch(m_inotify, it->first);
+			it = m_directories.erase(it);
+		}
+		else
+			++it;
+	}
+	for (const std::string& directory : directories)
+	{
+		bool watched = std::any_of(m_directories.begin(), m_directories.end(), [&](const auto& entry) { return entry.second == directory; });
+		if (watched)
+			continue;
+		int descriptor = inotify_add_watch(m_inotify, directory.c_str(), watch_mask);
+		if (descriptor >= 0)
+			m_directories[descriptor] = directory;
+		else
+			std::cout << "ERROR :: Could not watch directory \"" << directory << "\"" << std::endl;
+	}
+}
+
+#else
+
+void AssetWatcher::sync_directories()
+{
+	m_sync_directories = false;
+}
+
+#endif
+
+void AssetWatcher::start_reload(const std::shared_ptr<WatchedAsset>& asset)
+{
+	asset->m_changed = false;
+	asset->m_loading = true;
+	asset->m_progress.cancel = false;
+	asset->m_progress.bytes = 0;
+	asset->m_progress.total = 0;
+	m_reloads++;
+	async_pool().submit([this, asset]() { reload(asset); });
+}
+
+void AssetWatcher::reload(const std::shared_ptr<WatchedAsset>& asset)
+{
+	auto result = std::make_shared<WatchedMesh>();
+	bool loaded = false;
+	bool out_of_memory = false;
+	try
+	{
+		loaded = asset->m_context.load_mesh(asset->m_path.c_str(), result->mesh, asset->m_indexed, asset->m_options, &result->parts, &result->stats);
+	}
+	catch (const std::bad_alloc&)
+	{
+		std::cout << "ERROR :: Out of memory reloading \"" << asset->m_path << "\"" << std::endl;
+		out_of_memory = true;
+	}
+
+	// Like an asynchronous load, a file without faces loads as an empty mesh and one that could not be read fails
+	bool parsed = std::any_of(result->stats.spans.begin(), result->stats.spans.end(), [](const LoadSpan& span) { return span.phase == LoadPhase::Parse; });
+	LoadStatus status = asset->m_progress.cancel ? LoadStatus::Cancelled
+		: !out_of_memory && (loaded || parsed) ? LoadStatus::Loaded : LoadStatus::Failed;
+	if (status == LoadStatus::Loaded)
+	{
+		result->generation = ++asset->m_generation;
+		std::atomic_store(&asset->m_mesh, std::shared_ptr<const WatchedMesh>(std::move(result)));
+	}
+	asset->m_status = status;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (status == LoadStatus::Loaded)
+		{
+			// The libraries the file names now replace the ones it named before
+			std::vector<WatchedAsset::File> files(1, asset->m_files.front());
+			for (const std::string& library : asset->mesh()->parts.libraries)
+			{
+				std::string path = watched_path(library);
+				auto known = std::find_if(asset->m_files.begin(), asset->m_files.end(), [&](const WatchedAsset::File& file) { return file.path == path; });
+				files.push_back(known != asset->m_files.end() ? *known : WatchedAsset::File{ path });
+			}
+			asset->m_files.swap(files);
+			m_sync_directories = m_inotify >= 0;
+		}
+		asset->m_loading = false;
+	}
+	if (status == LoadStatus::Loaded && m_options.reloaded)
+		m_options.reloaded(*asset);
+
+	// The watcher may be destroyed as soon as the count drops, so the wake comes first
+	wake();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_reloads--;
+	m_idle.notify_all();
+}
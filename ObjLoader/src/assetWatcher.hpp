@@ -0,0 +1,150 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "asyncLoad.hpp"
+#include "objFileLoader.hpp"
+
+// One finished load of a watched file, never changed once it is published
+struct WatchedMesh
+{
+	Mesh mesh;
+	MeshParts parts;
+	LoadStats stats;
+	// Counts the loads of the asset that were published, the first one is 1
+	unsigned int generation = 0;
+};
+
+class WatchedAsset;
+
+struct WatchOptions
+{
+	// A reload starts once the files of an asset saw no change for this long, so a save written in many steps loads once
+	std::chrono::milliseconds debounce{ 100 };
+	// Files that keep changing reload at the latest this long after their first change
+	std::chrono::milliseconds max_delay{ 1000 };
+	// How often the files are checked when inotify is not available
+	std::chrono::milliseconds poll_interval{ 250 };
+	// Check the files on a timer even where inotify is available
+	bool force_polling = false;
+	// Runs on the loader pool thread after a new mesh was published, it must not destroy the watcher
+	std::function<void(WatchedAsset& asset)> reloaded;
+};
+
+// File loaded by an AssetWatcher, reloaded whenever the file or a material library it names changes
+class WatchedAsset
+{
+public:
+	WatchedAsset(const WatchedAsset&) = delete;
+	WatchedAsset& operator=(const WatchedAsset&) = delete;
+
+	// Last mesh that loaded, null until the first load finished, never blocks
+	// A reload publishes a new mesh and leaves the ones already handed out as they were
+	std::shared_ptr<const WatchedMesh> mesh() const { return std::atomic_load(&m_mesh); }
+
+	const std::string& path() const { return m_path; }
+	// How the last load ended, the mesh of the one before stays published when a reload fails
+	LoadStatus status() const { return m_status; }
+	bool loading() const { return m_loading; }
+
+private:
+	friend class AssetWatcher;
+
+	struct File
+	{
+		std::string path;
+		// Only kept when the watcher polls
+		std::filesystem::file_time_type time{};
+		std::uintmax_t size = 0;
+		bool exists = false;
+		bool checked = false;
+	};
+
+	WatchedAsset(const std::string& path, bool indexed, const LoadOptions& options);
+
+	std::string m_path;
+	bool m_indexed = false;
+	std::string m_cache_path;
+	LoadOptions m_options;
+	LoadProgress m_progress;
+	// Reloads of the same file parse only the chunks that changed
+	LoadContext m_context;
+
+	std::shared_ptr<const WatchedMesh> m_mesh;
+	std::atomic<LoadStatus> m_status{ LoadStatus::Failed };
+	std::atomic<bool> m_loading{ false };
+	unsigned int m_generation = 0;
+
+	// Guarded by the watcher, the file itself and the libraries of the last load
+	std::vector<File> m_files;
+	bool m_changed = false;
+	std::chrono::steady_clock::time_point m_first_change;
+	std::chrono::steady_clock::time_point m_last_change;
+};
+
+// Watches files on a thread of its own and reloads them on the loader pool
+// The thread that draws only ever reads the published mesh of an asset, it never waits on a parse
+// inotify reports the changes on Linux, elsewhere the files are polled
+class AssetWatcher
+{
+public:
+	explicit AssetWatcher(const WatchOptions& options = {});
+	// Cancels the reloads still running and waits for them
+	~AssetWatcher();
+
+	AssetWatcher(const AssetWatcher&) = delete;
+	AssetWatcher& operator=(const AssetWatcher&) = delete;
+
+	// Starts the first load at once and returns, like loadMesh with parts collected
+	// options is copied, its progress is ignored and incremental is always on
+	// The arrays of every mesh come from options.memory, which has to outlive them
+	std::shared_ptr<WatchedAsset> watch(const char* path, bool indexed = false, const LoadOptions& options = {});
+
+	// Stops reloading the asset and cancels its reload, the mesh it published stays
+	void unwatch(const std::shared_ptr<WatchedAsset>& asset);
+
+	// False when the files are polled
+	bool uses_inotify() const { return m_inotify >= 0; }
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	void run();
+	// Sleeps until deadline, a wake or a change, and marks the assets whose files changed
+	void wait(std::unique_lock<std::mutex>& lock, Clock::time_point deadline);
+	void wake();
+	void mark_changed(const std::string& path, Clock::time_point now);
+	void poll_files(Clock::time_point now);
+	// Watches the directories holding the files of every asset and no others
+	void sync_directories();
+	void start_reload(const std::shared_ptr<WatchedAsset>& asset);
+	void reload(const std::shared_ptr<WatchedAsset>& asset);
+
+	WatchOptions m_options;
+	std::vector<std::shared_ptr<WatchedAsset>> m_assets;
+	int m_inotify = -1;
+	// eventfd waking the thread on Linux, elsewhere it waits on m_woken
+	int m_wake = -1;
+	// Directory of every inotify watch
+	std::map<int, std::string> m_directories;
+	bool m_sync_directories = false;
+
+	std::thread m_thread;
+	std::mutex m_mutex;
+	std::condition_variable m_woken;
+	std::condition_variable m_idle;
+	bool m_wake_pending = false;
+	unsigned int m_reloads = 0;
+	bool m_stop = false;
+};
@@ -0,0 +1,163 @@
+#include "asyncLoad.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <new>
+#include <vector>
+
+#include "threadPool.hpp"
+
+struct AsyncLoad::Shared
+{
+	std::string path;
+	std::string cache_path;
+	LoadOptions options;
+	bool indexed = false;
+	bool parts = false;
+
+	LoadProgress progress;
+	std::mutex mutex;
+	std::condition_variable finished;
+	bool done = false;
+	AsyncMesh mesh;
+	std::vector<std::function<void()>> continuations;
+};
+
+ThreadPool& async_pool()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void run_async_load(AsyncLoad::Shared& shared)
+{
+	AsyncMesh mesh;
+	const LoadOptions& options = shared.options;
+	float* vertices = nullptr;
+	unsigned int* indices = nullptr;
+	bool out_of_memory = false;
+	// The context and every staging array it holds are gone when the load returns
+	try
+	{
+		LoadContext context;
+		MeshParts* parts = shared.parts ? &mesh.parts : nullptr;
+		if (shared.indexed)
+			vertices = context.load_indexed(shared.path.c_str(), mesh.count, indices, mesh.index_count, mesh.position_size, mesh.normal_size, mesh.uv_size, options, &mesh.stats, parts);
+		else
+			vertices = context.load(shared.path.c_str(), mesh.count, mesh.position_size, mesh.normal_size, mesh.uv_size, options, parts, &mesh.stats);
+	}
+	catch (const std::bad_alloc&)
+	{
+		std::cout << "ERROR :: Out of memory loading \"" << shared.path << "\"" << std::endl;
+		out_of_memory = true;
+	}
+	mesh.vertices.reset(vertices);
+	mesh.indices.reset(indices);
+
+	// The loaders return null both for a file they could not read and for one without faces, only the latter got to the parse
+	bool parsed = std::any_of(mesh.stats.spans.begin(), mesh.stats.spans.end(), [](const LoadSpan& span) { return span.phase == LoadPhase::Parse; });
+	// The phases after the parse may finish a cancelled load, its output is dropped all the same
+	if (shared.progress.cancel)
+	{
+		mesh = AsyncMesh();
+		mesh.status = LoadStatus::Cancelled;
+	}
+	else
+		mesh.status = !out_of_memory && (vertices || parsed) ? LoadStatus::Loaded : LoadStatus::Failed;
+
+	std::vector<std::function<void()>> continuations;
+	{
+		std::lock_guard<std::mutex> lock(shared.mutex);
+		shared.mesh = std::move(mesh);
+		shared.done = true;
+		continuations.swap(shared.continuations);
+	}
+	shared.finished.notify_all();
+	for (auto& continuation : continuations)
+		continuation();
+}
+
+AsyncLoad start_async_load(const char* path, const LoadOptions& options, bool indexed, bool parts)
+{
+	AsyncLoad load;
+	auto shared = std::make_shared<AsyncLoad::Shared>();
+	shared->path = path;
+	shared->options = options;
+	// The caller's strings may be gone before the load starts
+	if (options.cache_path)
+	{
+		shared->cache_path = options.cache_path;
+		shared->options.cache_path = shared->cache_path.c_str();
+	}
+	shared->options.progress = &shared->progress;
+	shared->indexed = indexed;
+	shared->parts = parts;
+	load.m_shared = shared;
+
+	async_pool().submit([shared]() { run_async_load(*shared); });
+	return load;
+}
+
+bool AsyncLoad::ready() const
+{
+	std::lock_guard<std::mutex> lock(m_shared->mutex);
+	return m_shared->done;
+}
+
+void AsyncLoad::wait() const
+{
+	std::unique_lock<std::mutex> lock(m_shared->mutex);
+	m_shared->finished.wait(lock, [this] { return m_shared->done; });
+}
+
+AsyncMesh AsyncLoad::get()
+{
+	wait();
+	std::shared_ptr<Shared> shared = std::move(m_shared);
+	std::lock_guard<std::mutex> lock(shared->mutex);
+	return std::move(shared->mesh);
+}
+
+size_t AsyncLoad::bytes() const
+{
+	return m_shared->progress.bytes;
+}
+
+size_t AsyncLoad::total_bytes() const
+{
+	return m_shared->progress.total;
+}
+
+float AsyncLoad::progress() const
+{
+	size_t total = m_shared->progress.total;
+	if (ready())
+		return 1.0f;
+	return total ? static_cast<float>(static_cast<double>(m_shared->progress.bytes) / total) : 0.0f;
+}
+
+void AsyncLoad::cancel()
+{
+	m_shared->progress.cancel = true;
+}
+
+bool AsyncLoad::when_done(std::function<void()> done)
+{
+	std::lock_guard<std::mutex> lock(m_shared->mutex);
+	if (m_shared->done)
+		return false;
+	m_shared->continuations.push_back(std::move(done));
+	return true;
+}
+
+AsyncLoad loadObjectAsync(const char* path, const LoadOptions& options, bool parts)
+{
+	return start_async_load(path, options, false, parts);
+}
+
+AsyncLoad loadIndexedObjectAsync(const char* path, const LoadOptions& options, bool parts)
+{
+	return start_async_load(path, options, true, parts);
+}
@@ -0,0 +1,98 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#include <coroutine>
+#define OBJLOADER_COROUTINES 1
+#endif
+
+#include "objFileLoader.hpp"
+
+class ThreadPool;
+
+enum class LoadStatus
+{
+	Loaded,
+	Failed,		// The file could not be read, or the loader ran out of memory
+	Cancelled
+};
+
+// Output of an asynchronous load, owning its arrays
+struct AsyncMesh
+{
+	LoadStatus status = LoadStatus::Failed;
+	std::unique_ptr<float[]> vertices;
+	unsigned int count = 0;
+	// Only for indexed loads
+	std::unique_ptr<unsigned int[]> indices;
+	unsigned int index_count = 0;
+	unsigned int position_size = 0;
+	unsigned int normal_size = 0;
+	unsigned int uv_size = 0;
+	// Only filled when the load asked for parts
+	MeshParts parts;
+	LoadStats stats;
+};
+
+// Handle of a load running on the loader pool, moves like a std::future
+// Dropping the handle lets the load finish in the background, cancel it first to stop it early
+class AsyncLoad
+{
+public:
+	AsyncLoad() = default;
+
+	AsyncLoad(const AsyncLoad&) = delete;
+	AsyncLoad& operator=(const AsyncLoad&) = delete;
+	AsyncLoad(AsyncLoad&&) noexcept = default;
+	AsyncLoad& operator=(AsyncLoad&&) noexcept = default;
+
+	// False for a default constructed handle and once the result was taken
+	bool valid() const { return m_shared != nullptr; }
+	bool ready() const;
+	void wait() const;
+
+	// Waits for the load and takes its result, the handle is invalid afterwards
+	AsyncMesh get();
+
+	// Bytes of the file parsed so far and its size, the size is 0 until the file is open
+	size_t bytes() const;
+	size_t total_bytes() const;
+	// Parsed share of the file from 0 to 1, the phases after the parse are not part of it
+	float progress() const;
+
+	// Asks the load to stop, it frees its staging memory at its next check and ends as Cancelled
+	// A load that already finished still reports Loaded
+	void cancel();
+
+#ifdef OBJLOADER_COROUTINES
+	// co_await resumes the coroutine on the loader thread that finished the load and yields the result of get()
+	bool await_ready() const { return ready(); }
+	bool await_suspend(std::coroutine_handle<> waiting) { return when_done([waiting]() { waiting.resume(); }); }
+	AsyncMesh await_resume() { return get(); }
+#endif
+
+	// Runs done on the thread that finishes the load, false without running it when the load already finished
+	bool when_done(std::function<void()> done);
+
+	// Defined with the loader pool, opaque to callers
+	struct Shared;
+
+private:
+	friend AsyncLoad start_async_load(const char* path, const LoadOptions& options, bool indexed, bool parts);
+
+	std::shared_ptr<Shared> m_shared;
+};
+
+// Starts a load of loadObject on the loader pool and returns at once
+// options is copied, a progress of its own is ignored as the handle reports progress instead
+// parts also collects the materials and ranges of loadObject, which skips the cache
+AsyncLoad loadObjectAsync(const char* path, const LoadOptions& options = {}, bool parts = false);
+
+// Same for loadIndexedObject
+AsyncLoad loadIndexedObjectAsync(const char* path, const LoadOptions& options = {}, bool parts = false);
+
+// Pool of its own running the asynchronous loads, a load occupies a thread for its whole run while the shared pool parses its chunks
+ThreadPool& async_pool();
@@ -0,0 +1,217 @@
+#include "blockReader.hpp"
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+void BlockReader::open_file(const char* path)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_file = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		close();
+		return;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_open = true;
+}
+
+bool BlockReader::read_at(char* out, size_t offset, size_t length)
+{
+	// A synchronous handle still takes the offset of every read, so readers never share a file position
+	while (length > 0)
+	{
+		OVERLAPPED overlapped{};
+		overlapped.Offset = static_cast<DWORD>(offset);
+		overlapped.OffsetHigh = static_cast<DWORD>(static_cast<unsigned long long>(offset) >> 32);
+		DWORD request = length > (1u << 30) ? (1u << 30) : static_cast<DWORD>(length);
+		DWORD read = 0;
+		if (!ReadFile(static_cast<HANDLE>(m_file), out, request, &read, &overlapped) || read == 0)
+			return false;
+		out += read;
+		offset += read;
+		length -= read;
+	}
+	return true;
+}
+
+void BlockReader::close()
+{
+	if (m_file)
+		CloseHandle(m_file);
+	m_file = nullptr;
+	m_open = false;
+}
+
+#else
+
+void BlockReader::open_file(const char* path)
+{
+	m_fd = open(path, O_RDONLY);
+	if (m_fd < 0)
+		return;
+
+	struct stat info{};
+	if (fstat(m_fd, &info) != 0)
+	{
+		close();
+		return;
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	m_open = true;
+#ifdef POSIX_FADV_SEQUENTIAL
+	// Larger read ahead on top of the reads in flight
+	posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+}
+
+bool BlockReader::read_at(char* out, size_t offset, size_t length)
+{
+	while (length > 0)
+	{
+		ssize_t read = pread(m_fd, out, length, static_cast<off_t>(offset));
+		if (read < 0 && errno == EINTR)
+			continue;
+		if (read <= 0)
+			return false;
+		out += read;
+		offset += static_cast<size_t>(read);
+		length -= static_cast<size_t>(read);
+	}
+	return true;
+}
+
+void BlockReader::close()
+{
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_fd = -1;
+	m_open = false;
+}
+
+#endif
+
+BlockReader::BlockReader(const char* path, size_t block_size, unsigned int buffers, unsigned int readers)
+{
+	open_file(path);
+	if (!m_open)
+		return;
+
+	m_block_size = block_size ? block_size : 1;
+	m_block_count = (m_size + m_block_size - 1) / m_block_size;
+	if (m_block_count == 0)
+		return;
+
+	// Small files need no more buffers than blocks
+	if (buffers < 1)
+		buffers = 1;
+	if (buffers > m_block_count)
+		buffers = static_cast<unsigned int>(m_block_count);
+	size_t buffer_size = m_block_size < m_size ? m_block_size : m_size;
+	m_slots.resize(buffers);
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		// Not value initialized, every byte handed out was read first
+		m_slots[i].buffer.reset(new char[buffer_size]);
+		m_slots[i].free_for = i;
+	}
+
+	if (readers < 1)
+		readers = 1;
+	if (readers > buffers)
+		readers = buffers;
+	for (unsigned int i = 0; i < readers; i++)
+		m_readers.emplace_back(&BlockReader::read_blocks, this);
+}
+
+BlockReader::~BlockReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_freed.notify_all();
+	for (auto& reader : m_readers)
+		reader.join();
+	close();
+}
+
+bool BlockReader::failed() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_failed;
+}
+
+void BlockReader::read_blocks()
+{
+	for (;;)
+	{
+		size_t block;
+		Slot* slot;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			if (m_stop || m_failed || m_next_read >= m_block_count)
+				return;
+			block = m_next_read++;
+			slot = &m_slots[block % m_slots.size()];
+			// The consumer has to be done with the block that used the buffer before
+			m_freed.wait(lock, [&] { return m_stop || m_failed || slot->free_for == block; });
+			if (m_stop || m_failed)
+				return;
+		}
+
+		size_t offset = block * m_block_size;
+		size_t length = m_size - offset < m_block_size ? m_size - offset : m_block_size;
+		bool read = read_at(slot->buffer.get(), offset, length);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			slot->length = length;
+			slot->ready = block;
+			if (!read)
+				m_failed = true;
+		}
+		m_read.notify_all();
+		if (!read)
+			m_freed.notify_all();
+	}
+}
+
+std::string_view BlockReader::next(size_t& index)
+{
+	index = m_next_block;
+	if (m_next_block >= m_block_count)
+		return {};
+
+	Slot& slot = m_slots[m_next_block % m_slots.size()];
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_read.wait(lock, [&] { return m_failed || slot.ready == index; });
+	if (m_failed)
+		return {};
+	m_next_block++;
+	return std::string_view(slot.buffer.get(), slot.length);
+}
+
+void BlockReader::release(size_t index)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Slot& slot = m_slots[index % m_slots.size()];
+		slot.ready = ~size_t(0);
+		slot.free_for = index + m_slots.size();
+	}
+	m_freed.notify_all();
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+// Input handed out in blocks in file order, each stays valid until it is released
+class BlockSource
+{
+public:
+	virtual ~BlockSource() = default;
+
+	// Next block, waiting for it to be ready, index receives its number
+	// Empty at the end of the input and after a failure, only one thread at a time may call it
+	virtual std::string_view next(size_t& index) = 0;
+
+	// The buffer of a block goes back to the source, blocks may be released in any order
+	virtual void release(size_t index) = 0;
+
+	// True once the input could not be read, the blocks after the failure are never handed out
+	virtual bool failed() const = 0;
+};
+
+// Reads a file front to back into a ring of buffers, with a read in flight per reader thread ahead of the consumer
+class BlockReader : public BlockSource
+{
+public:
+	// Every reader thread keeps one read in flight, buffers should exceed readers by the blocks the consumer holds at once
+	BlockReader(const char* path, size_t block_size, unsigned int buffers, unsigned int readers);
+	~BlockReader();
+
+	BlockReader(const BlockReader&) = delete;
+	BlockReader& operator=(const BlockReader&) = delete;
+
+	bool is_open() const { return m_open; }
+	size_t size() const { return m_size; }
+	bool failed() const override;
+	std::string_view next(size_t& index) override;
+	void release(size_t index) override;
+
+private:
+	struct Slot
+	{
+		std::unique_ptr<char[]> buffer;
+		size_t length = 0;
+		// Block the slot may be read into next, and the block it holds once that read finished
+		size_t free_for = 0;
+		size_t ready = ~size_t(0);
+	};
+
+	// Opens the file and takes its size, m_open stays false on failure
+	void open_file(const char* path);
+	void read_blocks();
+	// Reads length bytes at offset, false on an error or an early end of file
+	bool read_at(char* out, size_t offset, size_t length);
+	void close();
+
+	size_t m_size = 0;
+	size_t m_block_size = 0;
+	size_t m_block_count = 0;
+	bool m_open = false;
+#ifdef _WIN32
+	void* m_file = nullptr;
+#else
+	int m_fd = -1;
+#endif
+
+	std::vector<Slot> m_slots;
+	std::vector<std::thread> m_readers;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_freed;
+	std::condition_variable m_read;
+	size_t m_next_read = 0;
+	size_t m_next_block = 0;
+	bool m_failed = false;
+	bool m_stop = false;
+};
@@ -0,0 +1,382 @@
+#include "compressedInput.hpp"
+
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+
+#include "loadTrace.hpp"
+
+#ifdef OBJLOADER_USE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef OBJLOADER_USE_ZSTD
+#include <zstd.h>
+#endif
+
+Compression detect_compression(const char* path)
+{
+	std::FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return Compression::None;
+	unsigned char magic[4] = {};
+	size_t read = std::fread(magic, 1, sizeof(magic), file);
+	std::fclose(file);
+
+	if (read >= 2 && magic[0] == 0x1F && magic[1] == 0x8B)
+		return Compression::Gzip;
+	if (read == 4 && magic[0] == 0x28 && magic[1] == 0xB5 && magic[2] == 0x2F && magic[3] == 0xFD)
+		return Compression::Zstd;
+	return Compression::None;
+}
+
+const char* compression_name(Compression compression)
+{
+	switch (compression)
+	{
+	case Compression::Gzip:	return "gzip";
+	case Compression::Zstd:	return "zstd";
+	default:				return "none";
+	}
+}
+
+bool compression_supported(Compression compression)
+{
+	switch (compression)
+	{
+#ifdef OBJLOADER_USE_ZLIB
+	case Compression::Gzip:	return true;
+#endif
+#ifdef OBJLOADER_USE_ZSTD
+	case Compression::Zstd:	return true;
+#endif
+	case Compression::None:	return true;
+	default:				return false;
+	}
+}
+
+class Decoder
+{
+public:
+	virtual ~Decoder() = default;
+
+	// Writes up to size decompressed bytes and returns how many, fewer only at the end of the input
+	// error is set for damaged input and for a file that ends inside a stream
+	virtual size_t fill(char* out, size_t size, bool& error) = 0;
+};
+
+// Compressed bytes read from the file in large reads, owns the file
+class CompressedInput
+{
+public:
+	explicit CompressedInput(std::FILE* file) : m_file(file), m_buffer(new unsigned char[buffer_size]) {}
+	~CompressedInput() { std::fclose(m_file); }
+
+	CompressedInput(const CompressedInput&) = delete;
+	CompressedInput& operator=(const CompressedInput&) = delete;
+
+	// Bytes of the next read, 0 at the end of the file or on an error
+	size_t refill()
+	{
+		size_t read = std::fread(m_buffer.get(), 1, buffer_size, m_file);
+		if (read == 0 && std::ferror(m_file))
+			m_error = true;
+		return read;
+	}
+
+	unsigned char* data() const { return m_buffer.get(); }
+	bool error() const { return m_error; }
+
+private:
+	static const size_t buffer_size = 1 << 20;
+
+	std::FILE* m_file;
+	std::unique_ptr<unsigned char[]> m_buffer;
+	bool m_error = false;
+};
+
+#ifdef OBJLOADER_USE_ZLIB
+
+class GzipDecoder : public Decoder
+{
+public:
+	explicit GzipDecoder(std::FILE* file) : m_input(file)
+	{
+		// 32 lets zlib accept the gzip and the zlib header
+		m_ready = inflateInit2(&m_stream, 15 + 32) == Z_OK;
+	}
+
+	~GzipDecoder() override
+	{
+		if (m_ready)
+			inflateEnd(&m_stream);
+	}
+
+	bool is_ready() const { return m_ready; }
+
+	size_t fill(char* out, size_t size, bool& error) override
+	{
+		m_stream.next_out = reinterpret_cast<Bytef*>(out);
+		m_stream.avail_out = static_cast<uInt>(size);
+		while (m_stream.avail_out > 0)
+		{
+			if (m_stream.avail_in == 0)
+			{
+				size_t read = m_input.refill();
+				if (read == 0)
+				{
+					// The file may only end between members
+					error = m_input.error() || m_in_member;
+					break;
+				}
+				m_stream.next_in = m_input.data();
+				m_stream.avail_in = static_cast<uInt>(read);
+			}
+
+			m_in_member = true;
+			int result = inflate(&m_stream, Z_NO_FLUSH);
+			if (result == Z_STREAM_END)
+			{
+				// Concatenated members decompress as one stream, like gunzip does
+				m_in_member = false;
+				inflateReset(&m_stream);
+			}
+			else if (result != Z_OK && !(result == Z_BUF_ERROR && m_stream.avail_in == 0))
+			{
+				error = true;
+				break;
+			}
+		}
+		return size - m_stream.avail_out;
+	}
+
+private:
+	CompressedInput m_input;
+	z_stream m_stream{};
+	bool m_ready = false;
+	bool m_in_member = false;
+};
+
+#endif
+
+#ifdef OBJLOADER_USE_ZSTD
+
+class ZstdDecoder : public Decoder
+{
+public:
+	explicit ZstdDecoder(std::FILE* file) : m_input(file), m_stream(ZSTD_createDStream())
+	{
+		if (m_stream)
+			ZSTD_initDStream(m_stream);
+	}
+
+	~ZstdDecoder() override
+	{
+		ZSTD_freeDStream(m_stream);
+	}
+
+	bool is_ready() const { return m_stream != nullptr; }
+
+	size_t fill(char* out, size_t size, bool& error) override
+	{
+		ZSTD_outBuffer output{ out, size, 0 };
+		while (output.pos < output.size)
+		{
+			if (m_in.pos == m_in.size)
+			{
+				size_t read = m_input.refill();
+				if (read == 0)
+				{
+					// Frames follow each other, the file may only end between them
+					error = m_input.error() || m_in_frame;
+					break;
+				}
+				m_in = ZSTD_inBuffer{ m_input.data(), read, 0 };
+			}
+
+			size_t result = ZSTD_decompressStream(m_stream, &output, &m_in);
+			if (ZSTD_isError(result))
+			{
+				error = true;
+				break;
+			}
+			m_in_frame = result != 0;
+		}
+		return output.pos;
+	}
+
+private:
+	CompressedInput m_input;
+	ZSTD_DStream* m_stream;
+	ZSTD_inBuffer m_in{ nullptr, 0, 0 };
+	bool m_in_frame = false;
+};
+
+#endif
+
+// Size the compressor stored for the decompressed data, 0 when unknown, leaves the file at its start
+size_t stored_size(std::FILE* file, Compression compression)
+{
+	size_t size = 0;
+	if (compression == Compression::Gzip)
+	{
+		// The last four bytes of a gzip member, little endian and modulo 4 GB
+		unsigned char trailer[4];
+		if (std::fseek(file, -4, SEEK_END) == 0 && std::fread(trailer, 1, 4, file) == 4)
+			size = static_cast<size_t>(trailer[0]) | static_cast<size_t>(trailer[1]) << 8 | static_cast<size_t>(trailer[2]) << 16 | static_cast<size_t>(trailer[3]) << 24;
+	}
+#ifdef OBJLOADER_USE_ZSTD
+	else if (compression == Compression::Zstd)
+	{
+		// The frame header holds it when the compressor knew the size up front
+		unsigned char header[ZSTD_FRAMEHEADERSIZE_MAX];
+		size_t read = std::fread(header, 1, sizeof(header), file);
+		unsigned long long content = ZSTD_getFrameContentSize(header, read);
+		if (content != ZSTD_CONTENTSIZE_UNKNOWN && content != ZSTD_CONTENTSIZE_ERROR)
+			size = static_cast<size_t>(content);
+	}
+#endif
+	std::fseek(file, 0, SEEK_SET);
+	return size;
+}
+
+// Decoder reading from file, which it owns from then on, null when the format is not built in
+std::unique_ptr<Decoder> make_decoder(std::FILE* file, [[maybe_unused]] Compression compression)
+{
+#ifdef OBJLOADER_USE_ZLIB
+	if (compression == Compression::Gzip)
+	{
+		auto decoder = std::make_unique<GzipDecoder>(file);
+		return decoder->is_ready() ? std::move(decoder) : nullptr;
+	}
+#endif
+#ifdef OBJLOADER_USE_ZSTD
+	if (compression == Compression::Zstd)
+	{
+		auto decoder = std::make_unique<ZstdDecoder>(file);
+		return decoder->is_ready() ? std::move(decoder) : nullptr;
+	}
+#endif
+	std::fclose(file);
+	return nullptr;
+}
+
+DecompressReader::DecompressReader(const char* path, Compression compression, size_t block_size, unsigned int buffers, bool timed, std::chrono::steady_clock::time_point origin)
+	: m_path(path), m_block_size(block_size ? block_size : 1), m_timed(timed), m_origin(origin)
+{
+	std::FILE* file = std::fopen(path, "rb");
+	if (!file)
+		return;
+	std::error_code error;
+	m_compressed_size = static_cast<size_t>(std::filesystem::file_size(path, error));
+	m_expected_size = stored_size(file, compression);
+	m_decoder = make_decoder(file, compression);
+	if (!m_decoder)
+		return;
+
+	m_slots.resize(buffers < 1 ? 1 : buffers);
+	for (size_t i = 0; i < m_slots.size(); i++)
+	{
+		m_slots[i].buffer.reset(new char[m_block_size]);
+		m_slots[i].free_for = i;
+	}
+	m_open = true;
+	m_thread = std::thread(&DecompressReader::decompress, this);
+}
+
+DecompressReader::~DecompressReader()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_freed.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+bool DecompressReader::failed() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_failed;
+}
+
+void DecompressReader::decompress()
+{
+	for (size_t block = 0;; block++)
+	{
+		Slot& slot = m_slots[block % m_slots.size()];
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_freed.wait(lock, [&] { return m_stop || slot.free_for == block; });
+			if (m_stop)
+				return;
+		}
+
+		auto start = std::chrono::steady_clock::now();
+		double cpu_start = m_timed ? thread_cpu_ms() : 0.0;
+		size_t length = 0;
+		bool error = false;
+		while (length < m_block_size && !error)
+		{
+			size_t produced = m_decoder->fill(slot.buffer.get() + length, m_block_size - length, error);
+			if (produced == 0)
+				break;
+			length += produced;
+		}
+		if (m_timed && length)
+		{
+			LoadSpan span;
+			span.phase = LoadPhase::Decompress;
+			span.start_ms = std::chrono::duration<double, std::milli>(start - m_origin).count();
+			span.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			span.cpu_ms = thread_cpu_ms() - cpu_start;
+			m_spans.push_back(span);
+		}
+
+		bool finished = error || length < m_block_size;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (error)
+			{
+				std::cout << "ERROR :: File \"" << m_path << "\" is damaged or truncated" << std::endl;
+				m_failed = true;
+			}
+			else if (length)
+			{
+				slot.length = length;
+				slot.ready = block;
+				m_produced = block + 1;
+			}
+			m_finished = finished;
+		}
+		m_ready.notify_all();
+		if (finished)
+			return;
+	}
+}
+
+std::string_view DecompressReader::next(size_t& index)
+{
+	index = m_next_block;
+	if (!m_open)
+		return {};
+
+	Slot& slot = m_slots[index % m_slots.size()];
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_ready.wait(lock, [&] { return m_failed || slot.ready == index || (m_finished && index >= m_produced); });
+	if (m_failed || slot.ready != index)
+		return {};
+	m_next_block++;
+	return std::string_view(slot.buffer.get(), slot.length);
+}
+
+void DecompressReader::release(size_t index)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		Slot& slot = m_slots[index % m_slots.size()];
+		slot.ready = ~size_t(0);
+		slot.free_for = index + m_slots.size();
+	}
+	m_freed.notify_all();
+}
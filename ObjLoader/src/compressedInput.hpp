@@ -0,0 +1,90 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "blockReader.hpp"
+#include "objFileLoader.hpp"
+
+// Decompression is only built in when the library is, define OBJLOADER_USE_ZLIB or OBJLOADER_USE_ZSTD and link it
+enum class Compression
+{
+	None,
+	Gzip,
+	Zstd
+};
+
+// From the magic bytes at the start of the file, None for plain text and files that cannot be read
+Compression detect_compression(const char* path);
+
+const char* compression_name(Compression compression);
+
+// True when this build can decompress the format
+bool compression_supported(Compression compression);
+
+// Format specific decoder behind DecompressReader, defined with the libraries
+class Decoder;
+
+// Decompresses a file on a thread of its own into a ring of blocks, which it hands out like a BlockReader
+class DecompressReader : public BlockSource
+{
+public:
+	// Spans of the decompression are only measured when timed, from origin on
+	DecompressReader(const char* path, Compression compression, size_t block_size, unsigned int buffers, bool timed, std::chrono::steady_clock::time_point origin);
+	~DecompressReader();
+
+	DecompressReader(const DecompressReader&) = delete;
+	DecompressReader& operator=(const DecompressReader&) = delete;
+
+	bool is_open() const { return m_open; }
+	size_t compressed_size() const { return m_compressed_size; }
+	// Decompressed size the compressor stored, 0 when it stored none, gzip only keeps it modulo 4 GB
+	size_t expected_size() const { return m_expected_size; }
+
+	bool failed() const override;
+	std::string_view next(size_t& index) override;
+	void release(size_t index) override;
+
+	// One span per decompressed block on lane 0, complete once next returned empty
+	const std::vector<LoadSpan>& spans() const { return m_spans; }
+
+private:
+	struct Slot
+	{
+		std::unique_ptr<char[]> buffer;
+		size_t length = 0;
+		size_t free_for = 0;
+		size_t ready = ~size_t(0);
+	};
+
+	void decompress();
+
+	std::string m_path;
+	std::unique_ptr<Decoder> m_decoder;
+	size_t m_block_size = 0;
+	size_t m_compressed_size = 0;
+	size_t m_expected_size = 0;
+	bool m_open = false;
+	bool m_timed = false;
+	std::chrono::steady_clock::time_point m_origin;
+	std::vector<LoadSpan> m_spans;
+
+	std::vector<Slot> m_slots;
+	std::thread m_thread;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_freed;
+	std::condition_variable m_ready;
+	// Blocks decompressed so far, final once m_finished is set
+	size_t m_produced = 0;
+	size_t m_next_block = 0;
+	bool m_finished = false;
+	bool m_failed = false;
+	bool m_stop = false;
+};
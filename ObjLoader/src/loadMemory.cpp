@@ -0,0 +1,99 @@
+#include "loadMemory.hpp"
+
+#include <cstdint>
+
+// First block of an arena, later ones double so a load of any size takes only a few
+const size_t arena_block_size = 1 << 20;
+
+Arena::Arena(std::pmr::memory_resource* upstream) : m_upstream(upstream ? upstream : std::pmr::get_default_resource()) {}
+
+Arena::~Arena()
+{
+	free_blocks();
+}
+
+void Arena::free_blocks()
+{
+	for (const Block& block : m_blocks)
+		m_upstream->deallocate(block.data, block.size, alignof(std::max_align_t));
+	m_blocks.clear();
+}
+
+void Arena::rewind()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_offset = 0;
+	m_used = 0;
+	m_allocated = 0;
+	if (m_blocks.size() < 2)
+		return;
+
+	// The blocks are freed before the merged one is taken, so the merge never holds both
+	size_t size = 0;
+	for (const Block& block : m_blocks)
+		size += block.size;
+	free_blocks();
+	m_blocks.push_back({ static_cast<char*>(m_upstream->allocate(size, alignof(std::max_align_t))), size });
+	m_allocated = 1;
+}
+
+void Arena::release()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	free_blocks();
+	m_offset = 0;
+	m_used = 0;
+	m_allocated = 0;
+}
+
+size_t Arena::blocks_allocated() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_allocated;
+}
+
+size_t Arena::used() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_used;
+}
+
+size_t Arena::capacity() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	size_t size = 0;
+	for (const Block& block : m_blocks)
+		size += block.size;
+	return size;
+}
+
+void* Arena::do_allocate(size_t bytes, size_t alignment)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	if (!m_blocks.empty())
+	{
+		const Block& block = m_blocks.back();
+		uintptr_t base = reinterpret_cast<uintptr_t>(block.data);
+		size_t start = static_cast<size_t>(((base + m_offset + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - base);
+		if (start <= block.size && bytes <= block.size - start)
+		{
+			m_offset = start + bytes;
+			m_used += bytes;
+			return block.data + start;
+		}
+	}
+
+	// The rest of the last block is left unused
+	size_t size = m_blocks.empty() ? arena_block_size : m_blocks.back().size * 2;
+	if (size < bytes + alignment)
+		size = bytes + alignment;
+	char* data = static_cast<char*>(m_upstream->allocate(size, alignof(std::max_align_t)));
+	m_blocks.push_back({ data, size });
+	m_allocated++;
+
+	uintptr_t base = reinterpret_cast<uintptr_t>(data);
+	size_t start = static_cast<size_t>(((base + alignment - 1) & ~(static_cast<uintptr_t>(alignment) - 1)) - base);
+	m_offset = start + bytes;
+	m_used += bytes;
+	return data + start;
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Memory resource handing out memory from large blocks, freed all at once
+// Staging arrays of a load live in one, so a load takes a few blocks instead of growing every array on its own
+// Safe to allocate from several threads, the chunks of a parallel parse grow their arrays at the same time
+class Arena : public std::pmr::memory_resource
+{
+public:
+	// Blocks come from upstream, the default resource when null
+	explicit Arena(std::pmr::memory_resource* upstream = nullptr);
+	~Arena() override;
+
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	// Everything handed out is free again, nothing allocated from the arena may be used afterwards
+	// The memory is kept and merged into one block, so the next use of the same size takes no new block
+	void rewind();
+
+	// Gives every block back to upstream
+	void release();
+
+	std::pmr::memory_resource* upstream() const { return m_upstream; }
+	// Blocks taken from upstream since the last rewind
+	size_t blocks_allocated() const;
+	// Bytes handed out since the last rewind, arrays that grew keep counting their old storage
+	size_t used() const;
+	// Bytes of all blocks held
+	size_t capacity() const;
+
+private:
+	struct Block
+	{
+		char* data;
+		size_t size;
+	};
+
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	// Single allocations are never given back, only rewind and release free memory
+	void do_deallocate(void*, size_t, size_t) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	void free_blocks();
+
+	std::pmr::memory_resource* m_upstream;
+	std::vector<Block> m_blocks;
+	// Allocations are served from the end of the last block
+	size_t m_offset = 0;
+	size_t m_used = 0;
+	size_t m_allocated = 0;
+	mutable std::mutex m_mutex;
+};
+
+// Array allocated from a memory resource, given back to it when the array is destroyed
+template <typename T>
+class OutputArray
+{
+	static_assert(std::is_trivially_destructible<T>::value, "output arrays hold plain values");
+
+public:
+	OutputArray() = default;
+	// Takes ownership of size values at data, which resource allocated
+	OutputArray(T* data, size_t size, std::pmr::memory_resource* resource) : m_data(data), m_size(size), m_resource(resource) {}
+	~OutputArray() { reset(); }
+
+	OutputArray(const OutputArray&) = delete;
+	OutputArray& operator=(const OutputArray&) = delete;
+
+	OutputArray(OutputArray&& other) noexcept
+		: m_data(std::exchange(other.m_data, nullptr)), m_size(std::exchange(other.m_size, 0)), m_resource(other.m_resource) {}
+
+	OutputArray& operator=(OutputArray&& other) noexcept
+	{
+		if (this != &other)
+		{
+			reset();
+			m_data = std::exchange(other.m_data, nullptr);
+			m_size = std::exchange(other.m_size, 0);
+			m_resource = other.m_resource;
+		}
+		return *this;
+	}
+
+	void reset()
+	{
+		if (m_data)
+			m_resource->deallocate(m_data, m_size * sizeof(T), alignof(T));
+		m_data = nullptr;
+		m_size = 0;
+	}
+
+	T* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	bool empty() const { return m_size == 0; }
+	T& operator[](size_t i) const { return m_data[i]; }
+	T* begin() const { return m_data; }
+	T* end() const { return m_data + m_size; }
+	std::pmr::memory_resource* resource() const { return m_resource; }
+
+private:
+	T* m_data = nullptr;
+	size_t m_size = 0;
+	std::pmr::memory_resource* m_resource = nullptr;
+};
@@ -0,0 +1,141 @@
+#include "loadTrace.hpp"
+
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <locale>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <time.h>
+#endif
+
+const char* load_phase_name(LoadPhase phase)
+{
+	switch (phase)
+	{
+	case LoadPhase::Read:		return "read";
+	case LoadPhase::Decompress:	return "decompress";
+	case LoadPhase::Parse:		return "parse";
+	case LoadPhase::Merge:		return "merge";
+	case LoadPhase::Normals:	return "normals";
+	case LoadPhase::Tangents:	return "tangents";
+	case LoadPhase::Dedup:		return "dedup";
+	case LoadPhase::Optimize:	return "optimize";
+	case LoadPhase::Output:		return "output";
+	default:					return "cache";
+	}
+}
+
+double process_cpu_ms()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	// 100 ns ticks
+	auto ticks = [](const FILETIME& time) { return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	return (ticks(kernel) + ticks(user)) / 10000.0;
+#else
+	timespec time;
+	if (clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &time) != 0)
+		return 0.0;
+	return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+double thread_cpu_ms()
+{
+#ifdef _WIN32
+	FILETIME creation, exit, kernel, user;
+	if (!GetThreadTimes(GetCurrentThread(), &creation, &exit, &kernel, &user))
+		return 0.0;
+	auto ticks = [](const FILETIME& time) { return (static_cast<unsigned long long>(time.dwHighDateTime) << 32) | time.dwLowDateTime; };
+	return (ticks(kernel) + ticks(user)) / 10000.0;
+#else
+	timespec time;
+	if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+		return 0.0;
+	return time.tv_sec * 1000.0 + time.tv_nsec / 1000000.0;
+#endif
+}
+
+LoadTimer::LoadTimer(LoadStats* stats) : m_stats(stats), m_origin(std::chrono::steady_clock::now())
+{
+	if (m_stats)
+		*m_stats = LoadStats();
+}
+
+LoadTimer::~LoadTimer()
+{
+	if (m_stats)
+		m_stats->total_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_origin).count();
+}
+
+PhaseTimer::PhaseTimer(LoadStats* stats, LoadPhase phase, std::chrono::steady_clock::time_point origin)
+	: m_stats(stats), m_phase(phase), m_origin(origin)
+{
+	if (!m_stats)
+		return;
+	m_start = std::chrono::steady_clock::now();
+	m_cpu_start = process_cpu_ms();
+}
+
+void PhaseTimer::stop()
+{
+	if (!m_stats)
+		return;
+	LoadSpan span;
+	span.phase = m_phase;
+	span.start_ms = std::chrono::duration<double, std::milli>(m_start - m_origin).count();
+	span.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_start).count();
+	span.cpu_ms = process_cpu_ms() - m_cpu_start;
+	m_stats->wall_ms[static_cast<unsigned int>(m_phase)] += span.wall_ms;
+	m_stats->cpu_ms[static_cast<unsigned int>(m_phase)] += span.cpu_ms;
+	m_stats->spans.push_back(span);
+	m_stats = nullptr;
+}
+
+bool write_load_trace(const LoadStats& stats, const char* path)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR :: Trace file \"" << path << "\" could not be created" << std::endl;
+		return false;
+	}
+
+	// Fixed notation keeps the microseconds of long loads, and JSON needs the decimal point whatever the global locale
+	file.imbue(std::locale::classic());
+	file << std::fixed << std::setprecision(3);
+
+	// Complete events in microseconds, one track per lane named by metadata events after the phase of its first span
+	std::vector<const LoadSpan*> first_spans(1, nullptr);
+	file << "{\"traceEvents\":[\n";
+	for (const LoadSpan& span : stats.spans)
+	{
+		file << "{\"name\":\"" << load_phase_name(span.phase) << "\",\"cat\":\"load\",\"ph\":\"X\",\"pid\":1,\"tid\":" << span.lane << ",\"ts\":" << span.start_ms * 1000.0
+			 << ",\"dur\":" << span.wall_ms * 1000.0 << ",\"args\":{\"cpu_ms\":" << span.cpu_ms << "}},\n";
+		if (span.lane >= first_spans.size())
+			first_spans.resize(span.lane + 1, nullptr);
+		if (!first_spans[span.lane])
+			first_spans[span.lane] = &span;
+	}
+	file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"load\"}}";
+	for (unsigned int lane = 1; lane < first_spans.size(); lane++)
+		if (first_spans[lane])
+			file << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << lane << ",\"args\":{\"name\":\"" << load_phase_name(first_spans[lane]->phase)
+				 << " " << lane << "\"}}";
+	file << "\n],\n\"displayTimeUnit\":\"ms\",\n";
+
+	file << "\"otherData\":{\"total_ms\":" << stats.total_ms << ",\"bytes\":" << stats.bytes << ",\"compressed_bytes\":" << stats.compressed_bytes << ",\"reused_bytes\":" << stats.reused_bytes << ",\"lines\":" << stats.lines
+		 << ",\"position_records\":" << stats.position_records << ",\"normal_records\":" << stats.normal_records << ",\"uv_records\":" << stats.uv_records
+		 << ",\"face_records\":" << stats.face_records << ",\"skipped_lines\":" << stats.skipped_lines << ",\"malformed_lines\":" << stats.malformed_lines
+		 << ",\"dropped_faces\":" << stats.dropped_faces << ",\"filtered_faces\":" << stats.filtered_faces << ",\"allocations\":" << stats.allocations
+		 << ",\"peak_staging_bytes\":" << stats.peak_staging_bytes << "}\n}\n";
+	return file.good();
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <chrono>
+
+#include "objFileLoader.hpp"
+
+// CPU time of the process in milliseconds, summed over every thread
+double process_cpu_ms();
+
+// CPU time of the calling thread in milliseconds
+double thread_cpu_ms();
+
+// Clears the stats at the start of a load and sets its total time however the load returns
+class LoadTimer
+{
+public:
+	explicit LoadTimer(LoadStats* stats);
+	~LoadTimer();
+
+	LoadTimer(const LoadTimer&) = delete;
+	LoadTimer& operator=(const LoadTimer&) = delete;
+
+	std::chrono::steady_clock::time_point origin() const { return m_origin; }
+
+private:
+	LoadStats* m_stats;
+	std::chrono::steady_clock::time_point m_origin;
+};
+
+// Adds the wall and CPU time of its scope to one phase of a load as a span on lane 0
+// Without stats it never reads a clock
+class PhaseTimer
+{
+public:
+	PhaseTimer(LoadStats* stats, LoadPhase phase, std::chrono::steady_clock::time_point origin);
+	~PhaseTimer() { stop(); }
+
+	PhaseTimer(const PhaseTimer&) = delete;
+	PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+	// Ends the span early, later calls do nothing
+	void stop();
+
+private:
+	LoadStats* m_stats;
+	LoadPhase m_phase;
+	std::chrono::steady_clock::time_point m_origin;
+	std::chrono::steady_clock::time_point m_start;
+	double m_cpu_start = 0.0;
+};
@@ -0,0 +1,143 @@
+#include "mappedFile.hpp"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+
+MappedFile::MappedFile(const char* path)
+{
+	HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	m_file = file;
+
+	LARGE_INTEGER size{};
+	if (!GetFileSizeEx(file, &size))
+	{
+		close();
+		return;
+	}
+	m_size = static_cast<size_t>(size.QuadPart);
+	m_open = true;
+	// Empty files cannot be mapped, but are still valid
+	if (m_size == 0)
+		return;
+
+	m_mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!m_mapping)
+	{
+		close();
+		return;
+	}
+	m_data = static_cast<const char*>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+	if (!m_data)
+	{
+		close();
+		return;
+	}
+
+	// Ask the memory manager to start paging in the whole view
+	WIN32_MEMORY_RANGE_ENTRY range{ const_cast<char*>(m_data), m_size };
+	PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		UnmapViewOfFile(m_data);
+	if (m_mapping)
+		CloseHandle(m_mapping);
+	if (m_file)
+		CloseHandle(m_file);
+	m_data = nullptr;
+	m_mapping = nullptr;
+	m_file = nullptr;
+	m_size = 0;
+	m_open = false;
+}
+
+#else
+
+MappedFile::MappedFile(const char* path)
+{
+	m_fd = open(path, O_RDONLY);
+	if (m_fd < 0)
+		return;
+
+	struct stat info{};
+	if (fstat(m_fd, &info) != 0)
+	{
+		close();
+		return;
+	}
+	m_size = static_cast<size_t>(info.st_size);
+	m_open = true;
+	// Empty files cannot be mapped, but are still valid
+	if (m_size == 0)
+		return;
+
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, m_fd, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return;
+	}
+	m_data = static_cast<const char*>(data);
+
+	// Read ahead aggressively and start paging in the whole mapping
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	madvise(data, m_size, MADV_WILLNEED);
+}
+
+void MappedFile::close()
+{
+	if (m_data)
+		munmap(const_cast<char*>(m_data), m_size);
+	if (m_fd >= 0)
+		::close(m_fd);
+	m_data = nullptr;
+	m_fd = -1;
+	m_size = 0;
+	m_open = false;
+}
+
+#endif
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept
+{
+	*this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+{
+	if (this != &other)
+	{
+		close();
+		std::swap(m_data, other.m_data);
+		std::swap(m_size, other.m_size);
+		std::swap(m_open, other.m_open);
+#ifdef _WIN32
+		std::swap(m_file, other.m_file);
+		std::swap(m_mapping, other.m_mapping);
+#else
+		std::swap(m_fd, other.m_fd);
+#endif
+	}
+	return *this;
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+// Read-only memory mapping of a whole file
+// The mapping is advised for sequential access and prefetched on open
+class MappedFile
+{
+public:
+	MappedFile() = default;
+	explicit MappedFile(const char* path);
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	MappedFile(MappedFile&& other) noexcept;
+	MappedFile& operator=(MappedFile&& other) noexcept;
+
+	bool is_open() const { return m_open; }
+	const char* data() const { return m_data; }
+	size_t size() const { return m_size; }
+	std::string_view view() const { return std::string_view(m_data, m_size); }
+
+private:
+	void close();
+
+	const char* m_data = nullptr;
+	size_t m_size = 0;
+	bool m_open = false;
+#ifdef _WIN32
+	void* m_file = nullptr;
+	void* m_mapping = nullptr;
+#else
+	int m_fd = -1;
+#endif
+};
@@ -0,0 +1,124 @@
+#include "materialLibrary.hpp"
+
+#include <cstring>
+#include <iostream>
+#include <string_view>
+
+#include "mappedFile.hpp"
+#include "objTokenizer.hpp"
+
+// Exporters disagree on the case of keywords like map_Kd, so they are compared ignoring ASCII case
+bool same_keyword(std::string_view a, std::string_view b)
+{
+	if (a.size() != b.size())
+		return false;
+	for (size_t i = 0; i < a.size(); i++)
+		if ((a[i] | 0x20) != (b[i] | 0x20))
+			return false;
+	return true;
+}
+
+// Up to three components, a single value is used for all of them as some exporters write it
+void parse_color(Tokenizer& tokens, float color[3])
+{
+	float values[3];
+	int count = 0;
+	while (count < 3 && tokens.parse_float(values[count]))
+		count++;
+	for (int i = 0; i < 3 && count > 0; i++)
+		color[i] = values[count == 3 ? i : 0];
+}
+
+// Texture options like -bm 1 or -o 0 0 come first, the file name is the last token
+std::string parse_map(Tokenizer& tokens)
+{
+	std::string_view name;
+	for (std::string_view token = tokens.next_token(); !token.empty(); token = tokens.next_token())
+		name = token;
+	return std::string(name);
+}
+
+void parse_material_line(std::string_view line, std::vector<Material>& materials, bool& open)
+{
+	Tokenizer tokens(line);
+	std::string_view head = tokens.next_token();
+	if (head.empty() || head[0] == '#')
+		return;
+
+	if (same_keyword(head, "newmtl"))
+	{
+		materials.emplace_back();
+		materials.back().name = std::string(tokens.rest());
+		open = true;
+		return;
+	}
+	// Anything before the first newmtl has no material to go to
+	if (!open)
+		return;
+
+	Material& material = materials.back();
+	if (same_keyword(head, "Ka"))
+		parse_color(tokens, material.ambient);
+	else if (same_keyword(head, "Kd"))
+		parse_color(tokens, material.diffuse);
+	else if (same_keyword(head, "Ks"))
+		parse_color(tokens, material.specular);
+	else if (same_keyword(head, "Ke"))
+		parse_color(tokens, material.emission);
+	else if (same_keyword(head, "Ns"))
+		tokens.parse_float(material.shininess);
+	else if (same_keyword(head, "d"))
+		tokens.parse_float(material.opacity);
+	else if (same_keyword(head, "Tr"))
+	{
+		float transparency;
+		if (tokens.parse_float(transparency))
+			material.opacity = 1.0f - transparency;
+	}
+	else if (same_keyword(head, "Ni"))
+		tokens.parse_float(material.refraction);
+	else if (same_keyword(head, "illum"))
+	{
+		unsigned int illumination;
+		tokens.skip_space();
+		if (tokens.parse_uint(illumination))
+			material.illumination = static_cast<int>(illumination);
+	}
+	else if (same_keyword(head, "map_Ka"))
+		material.ambient_map = parse_map(tokens);
+	else if (same_keyword(head, "map_Kd"))
+		material.diffuse_map = parse_map(tokens);
+	else if (same_keyword(head, "map_Ks"))
+		material.specular_map = parse_map(tokens);
+	else if (same_keyword(head, "map_Ns"))
+		material.shininess_map = parse_map(tokens);
+	else if (same_keyword(head, "map_d"))
+		material.alpha_map = parse_map(tokens);
+	else if (same_keyword(head, "map_Bump") || same_keyword(head, "bump"))
+		material.bump_map = parse_map(tokens);
+	else if (same_keyword(head, "norm"))
+		material.normal_map = parse_map(tokens);
+}
+
+bool parse_material_library(const char* path, std::vector<Material>& materials)
+{
+	MappedFile file(path);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR :: Material library \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+		return false;
+	}
+
+	bool open = false;
+	const char* it = file.data();
+	const char* end = it + file.size();
+	while (it != end)
+	{
+		const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+		if (!eol)
+			eol = end;
+		parse_material_line(std::string_view(it, eol - it), materials, open);
+		it = eol == end ? end : eol + 1;
+	}
+	return true;
+}
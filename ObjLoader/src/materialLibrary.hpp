@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+// One newmtl entry of a material library, values the library leaves out keep their defaults
+// Texture maps are file names relative to the library, their options are not kept
+struct Material
+{
+	std::string name;
+	float ambient[3] = { 0.0f, 0.0f, 0.0f };		// Ka
+	float diffuse[3] = { 0.8f, 0.8f, 0.8f };		// Kd
+	float specular[3] = { 0.0f, 0.0f, 0.0f };		// Ks
+	float emission[3] = { 0.0f, 0.0f, 0.0f };		// Ke
+	float shininess = 0.0f;							// Ns
+	float opacity = 1.0f;							// d, or 1 - Tr
+	float refraction = 1.0f;						// Ni
+	int illumination = 2;							// illum
+	std::string ambient_map;						// map_Ka
+	std::string diffuse_map;						// map_Kd
+	std::string specular_map;						// map_Ks
+	std::string shininess_map;						// map_Ns
+	std::string alpha_map;							// map_d
+	std::string bump_map;							// map_Bump or bump
+	std::string normal_map;							// norm
+};
+
+// Appends the materials of a library file, false when it could not be read
+bool parse_material_library(const char* path, std::vector<Material>& materials);
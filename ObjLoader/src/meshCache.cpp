@@ -0,0 +1,258 @@
+#include "meshCache.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <random>
+#include <string>
+#include <system_error>
+#include <vector>
+
+#include "threadPool.hpp"
+
+// Bump whenever the header or the output of the loader changes
+const uint32_t cache_version = 3;
+const char cache_magic[8] = { 'O', 'B', 'J', 'C', 'A', 'C', 'H', 'E' };
+
+// Payloads start on cache line boundaries, so a mapped cache can be read in place
+const uint64_t payload_alignment = 64;
+
+// Source files are hashed in blocks across the pool, the block hashes are combined in order
+const size_t hash_block_size = 4 << 20;
+
+// Fixed size header at the start of every cache file, stored in native byte order
+struct CacheHeader
+{
+	char magic[8];
+	uint32_t version;
+	uint32_t reserved;
+	uint64_t layout;
+	uint64_t source_size;
+	int64_t source_mtime;
+	uint64_t source_hash;
+	// Hash of the vertex and index arrays, a cache damaged after it was written fails it
+	uint64_t payload_hash;
+	uint32_t vertex_count;
+	uint32_t index_count;
+	uint32_t stride;
+	uint32_t position_size;
+	uint32_t normal_size;
+	uint32_t uv_size;
+	uint64_t vertex_offset;
+	uint64_t index_offset;
+	uint64_t file_size;
+};
+
+uint64_t align_up(uint64_t offset)
+{
+	return (offset + payload_alignment - 1) & ~(payload_alignment - 1);
+}
+
+uint64_t rotate_left(uint64_t v, int bits)
+{
+	return (v << bits) | (v >> (64 - bits));
+}
+
+uint64_t hash_mix(uint64_t h, uint64_t v)
+{
+	h ^= v * 0x9E3779B97F4A7C15ull;
+	return rotate_left(h, 31) * 0xBF58476D1CE4E5B9ull;
+}
+
+// Final avalanche so every input bit affects every output bit
+uint64_t hash_finish(uint64_t h)
+{
+	h ^= h >> 33;
+	h *= 0xFF51AFD7ED558CCDull;
+	h ^= h >> 33;
+	h *= 0xC4CEB9FE1A85EC53ull;
+	h ^= h >> 33;
+	return h;
+}
+
+// 64-bit hash of a block, four independent lanes keep the multipliers busy
+uint64_t hash_block(const char* data, size_t size)
+{
+	uint64_t lanes[4] = { 0x243F6A8885A308D3ull, 0x13198A2E03707344ull, 0xA4093822299F31D0ull, 0x082EFA98EC4E6C89ull };
+	size_t i = 0;
+	for (; i + 32 <= size; i += 32)
+	{
+		uint64_t words[4];
+		memcpy(words, data + i, sizeof(words));
+		for (int l = 0; l < 4; l++)
+			lanes[l] = hash_mix(lanes[l], words[l]);
+	}
+	// Tail padded with zeros, the size below tells paddings apart
+	for (int l = 0; i < size; i += 8, l++)
+	{
+		uint64_t word = 0;
+		memcpy(&word, data + i, size - i < 8 ? size - i : 8);
+		lanes[l] = hash_mix(lanes[l], word);
+	}
+
+	uint64_t h = size;
+	for (int l = 0; l < 4; l++)
+		h = hash_mix(h, lanes[l]);
+	return hash_finish(h);
+}
+
+uint64_t hash_contents(const char* data, size_t size, ThreadPool& pool, unsigned int threads)
+{
+	size_t blocks = (size + hash_block_size - 1) / hash_block_size;
+	std::vector<uint64_t> hashes(blocks);
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t first = b * hash_block_size;
+		size_t length = size - first < hash_block_size ? size - first : hash_block_size;
+		hashes[b] = hash_block(data + first, length);
+	}, threads);
+
+	uint64_t h = size;
+	for (uint64_t block : hashes)
+		h = hash_mix(h, block);
+	return hash_finish(h);
+}
+
+// Hash of the output arrays as stored in the cache
+uint64_t hash_payload(const CachePayload& payload, ThreadPool& pool, unsigned int threads)
+{
+	size_t vertex_bytes = static_cast<size_t>(payload.vertex_count) * payload.stride * sizeof(float);
+	size_t index_bytes = payload.indices ? static_cast<size_t>(payload.index_count) * sizeof(uint32_t) : 0;
+	uint64_t h = hash_contents(reinterpret_cast<const char*>(payload.vertices), vertex_bytes, pool, threads);
+	if (index_bytes)
+		h = hash_mix(h, hash_contents(reinterpret_cast<const char*>(payload.indices), index_bytes, pool, threads));
+	return hash_finish(h);
+}
+
+// Name of a temporary file next to the cache that no other writer uses, even in another process
+std::string temporary_cache_path(const char* cache_path)
+{
+	std::random_device random;
+	uint64_t suffix = static_cast<uint64_t>(random()) << 32 | random();
+	char name[24];
+	snprintf(name, sizeof(name), ".%016llx", static_cast<unsigned long long>(suffix));
+	return std::string(cache_path) + name + ".tmp";
+}
+
+bool make_cache_key(const char* path, uint64_t layout, ThreadPool& pool, unsigned int threads, CacheKey& key)
+{
+	MappedFile file(path);
+	if (!file.is_open())
+		return false;
+
+	std::error_code error;
+	auto mtime = std::filesystem::last_write_time(path, error);
+	if (error)
+		return false;
+
+	key.layout = layout;
+	key.source_size = file.size();
+	key.source_mtime = static_cast<int64_t>(mtime.time_since_epoch().count());
+	key.source_hash = hash_contents(file.data(), file.size(), pool, threads);
+	return true;
+}
+
+bool read_cache(const char* cache_path, const CacheKey& key, ThreadPool& pool, unsigned int threads, CachedMesh& mesh)
+{
+	MappedFile file(cache_path);
+	if (!file.is_open() || file.size() < sizeof(CacheHeader))
+		return false;
+
+	CacheHeader header;
+	memcpy(&header, file.data(), sizeof(header));
+	if (memcmp(header.magic, cache_magic, sizeof(cache_magic)) != 0 || header.version != cache_version)
+		return false;
+
+	// Stale, the source changed or the cache holds a different output
+	if (header.layout != key.layout || header.source_size != key.source_size || header.source_mtime != key.source_mtime ||
+		header.source_hash != key.source_hash)
+		return false;
+
+	// Damaged, a truncated or foreign file must not be read out of bounds
+	uint64_t vertex_bytes = static_cast<uint64_t>(header.vertex_count) * header.stride * sizeof(float);
+	uint64_t index_bytes = static_cast<uint64_t>(header.index_count) * sizeof(uint32_t);
+	if (header.file_size != file.size() || header.vertex_offset % payload_alignment || header.index_offset % payload_alignment ||
+		header.vertex_offset < sizeof(CacheHeader) || header.vertex_offset + vertex_bytes > file.size() ||
+		(index_bytes && (header.index_offset < header.vertex_offset + vertex_bytes || header.index_offset + index_bytes > file.size())))
+		return false;
+
+	CachePayload& payload = mesh.payload;
+	payload.vertices = reinterpret_cast<const float*>(file.data() + header.vertex_offset);
+	payload.indices = index_bytes ? reinterpret_cast<const uint32_t*>(file.data() + header.index_offset) : nullptr;
+	payload.vertex_count = header.vertex_count;
+	payload.index_count = header.index_count;
+	payload.stride = header.stride;
+	payload.position_size = header.position_size;
+	payload.normal_size = header.normal_size;
+	payload.uv_size = header.uv_size;
+	// Damaged payload, indices out of range would reach the caller
+	if (hash_payload(payload, pool, threads) != header.payload_hash)
+		return false;
+	mesh.file = std::move(file);
+	return true;
+}
+
+bool write_cache(const char* cache_path, const CacheKey& key, const CachePayload& payload, ThreadPool& pool, unsigned int threads)
+{
+	CacheHeader header{};
+	memcpy(header.magic, cache_magic, sizeof(cache_magic));
+	header.version = cache_version;
+	header.layout = key.layout;
+	header.source_size = key.source_size;
+	header.source_mtime = key.source_mtime;
+	header.source_hash = key.source_hash;
+	header.vertex_count = payload.vertex_count;
+	header.index_count = payload.indices ? payload.index_count : 0;
+	header.stride = payload.stride;
+	header.position_size = payload.position_size;
+	header.normal_size = payload.normal_size;
+	header.uv_size = payload.uv_size;
+	header.payload_hash = hash_payload(payload, pool, threads);
+
+	uint64_t vertex_bytes = static_cast<uint64_t>(header.vertex_count) * header.stride * sizeof(float);
+	uint64_t index_bytes = static_cast<uint64_t>(header.index_count) * sizeof(uint32_t);
+	header.vertex_offset = align_up(sizeof(CacheHeader));
+	header.index_offset = align_up(header.vertex_offset + vertex_bytes);
+	header.file_size = index_bytes ? header.index_offset + index_bytes : header.vertex_offset + vertex_bytes;
+
+	// Readers never see a half written cache, the complete file replaces the old one in one rename
+	// Loads warming the same cache at once each write their own file, the last rename wins
+	std::string temporary = temporary_cache_path(cache_path);
+	std::error_code error;
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR :: Cache \"" << cache_path << "\" could not be written" << std::endl;
+			return false;
+		}
+
+		const char padding[payload_alignment] = {};
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(padding, header.vertex_offset - sizeof(header));
+		file.write(reinterpret_cast<const char*>(payload.vertices), vertex_bytes);
+		if (index_bytes)
+		{
+			file.write(padding, header.index_offset - header.vertex_offset - vertex_bytes);
+			file.write(reinterpret_cast<const char*>(payload.indices), index_bytes);
+		}
+		file.close();
+		if (!file)
+		{
+			std::cout << "ERROR :: Cache \"" << cache_path << "\" could not be written" << std::endl;
+			std::filesystem::remove(temporary, error);
+			return false;
+		}
+	}
+
+	std::filesystem::rename(temporary, cache_path, error);
+	if (error)
+	{
+		std::cout << "ERROR :: Cache \"" << cache_path << "\" could not be replaced" << std::endl;
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+	return true;
+}
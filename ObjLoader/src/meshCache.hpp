@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cstdint>
+
+#include "mappedFile.hpp"
+
+class ThreadPool;
+
+// Identifies the source a cache was built from and the output it holds
+// A cache only matches when every field is equal
+struct CacheKey
+{
+	// Hash of every option that changes the output
+	uint64_t layout = 0;
+	uint64_t source_size = 0;
+	int64_t source_mtime = 0;
+	uint64_t source_hash = 0;
+};
+
+// Output arrays of a load as stored in a cache, indices is null for unrolled output
+struct CachePayload
+{
+	const float* vertices = nullptr;
+	const uint32_t* indices = nullptr;
+	uint32_t vertex_count = 0;
+	uint32_t index_count = 0;
+	// Floats per vertex
+	uint32_t stride = 0;
+	uint32_t position_size = 0;
+	uint32_t normal_size = 0;
+	uint32_t uv_size = 0;
+};
+
+// A mapped cache file, the payload points into the mapping
+struct CachedMesh
+{
+	MappedFile file;
+	CachePayload payload;
+};
+
+// Size, modification time and content hash of the source file, false when it cannot be read
+bool make_cache_key(const char* path, uint64_t layout, ThreadPool& pool, unsigned int threads, CacheKey& key);
+
+// 64-bit hash of the bytes, also used to match the chunks of incremental loads
+uint64_t hash_block(const char* data, size_t size);
+
+// Maps the cache and checks it against the key, false when it is missing, stale or damaged
+// The payload is hashed across the pool and compared with the hash stored when it was written
+bool read_cache(const char* cache_path, const CacheKey& key, ThreadPool& pool, unsigned int threads, CachedMesh& mesh);
+
+// Writes the payload to a temporary file of its own and renames it over the old cache once complete
+bool write_cache(const char* cache_path, const CacheKey& key, const CachePayload& payload, ThreadPool& pool, unsigned int threads);
@@ -0,0 +1,319 @@
+#include "meshOptimizer.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+// Largest cache the scoring models, larger caches barely change the order
+const unsigned int max_cache_size = 64;
+// Vertices with more triangles left all get the valence score of this many
+const unsigned int max_scored_valence = 64;
+
+// Forsyth's vertex scores, looked up instead of evaluated for every update
+struct ScoreTables
+{
+	float cache[max_cache_size];
+	float valence[max_scored_valence + 1];
+
+	explicit ScoreTables(unsigned int cache_size)
+	{
+		// The vertices of the last triangle score alike, so the next one does not depend on its winding
+		for (unsigned int i = 0; i < cache_size; i++)
+			cache[i] = i < 3 ? 0.75f : std::pow(1.0f - static_cast<float>(i - 3) / (cache_size - 3), 1.5f);
+		// Vertices with few triangles left are finished first, before they become isolated
+		valence[0] = 0.0f;
+		for (unsigned int i = 1; i <= max_scored_valence; i++)
+			valence[i] = 2.0f / std::sqrt(static_cast<float>(i));
+	}
+
+	// position is the place in the cache, -1 when not cached
+	float score(int position, unsigned int live) const
+	{
+		return (position >= 0 ? cache[position] : 0.0f) + valence[live < max_scored_valence ? live : max_scored_valence];
+	}
+};
+
+// Cache optimization state of a vertex, its triangles are adjacency[first, first + live)
+struct VertexState
+{
+	size_t first = 0;
+	unsigned int live = 0;
+	float score = 0.0f;
+};
+
+VertexCacheStats analyze_vertex_cache(const unsigned int* indices, size_t index_count, unsigned int vertex_count, unsigned int cache_size)
+{
+	VertexCacheStats stats;
+	size_t triangles = index_count / 3;
+	if (!triangles || !vertex_count || !cache_size)
+		return stats;
+
+	// A vertex is cached while fewer than cache_size misses happened since it was loaded, 0 means never loaded
+	std::vector<size_t> loaded(vertex_count, 0);
+	size_t timestamp = cache_size + 1;
+	size_t misses = 0, used = 0;
+	for (size_t i = 0; i < triangles * 3; i++)
+	{
+		unsigned int v = indices[i];
+		if (timestamp - loaded[v] > cache_size)
+		{
+			used += loaded[v] == 0;
+			loaded[v] = timestamp++;
+			misses++;
+		}
+	}
+
+	stats.acmr = static_cast<double>(misses) / triangles;
+	stats.atvr = static_cast<double>(misses) / used;
+	return stats;
+}
+
+void optimize_vertex_cache(unsigned int* indices, size_t index_count, unsigned int vertex_count, unsigned int cache_size)
+{
+	size_t triangles = index_count / 3;
+	if (triangles < 2 || !vertex_count)
+		return;
+	cache_size = cache_size < 4 ? 4 : cache_size > max_cache_size ? max_cache_size : cache_size;
+	ScoreTables tables(cache_size);
+
+	// Triangles around every vertex, the live ones not emitted yet come first in its list
+	// Kept together per vertex, the cache updates touch all three for the same vertices
+	std::vector<VertexState> vertices(vertex_count);
+	for (size_t i = 0; i < triangles * 3; i++)
+		vertices[indices[i]].live++;
+	size_t offset = 0;
+	for (VertexState& vertex : vertices)
+	{
+		vertex.first = offset;
+		offset += vertex.live;
+		vertex.score = tables.score(-1, vertex.live);
+	}
+	std::vector<unsigned int> adjacency(triangles * 3);
+	{
+		std::vector<unsigned int> filled(vertex_count, 0);
+		for (size_t i = 0; i < triangles * 3; i++)
+			adjacency[vertices[indices[i]].first + filled[indices[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<float> triangle_score(triangles);
+	size_t best = 0;
+	for (size_t t = 0; t < triangles; t++)
+	{
+		const unsigned int* tri = indices + t * 3;
+		triangle_score[t] = vertices[tri[0]].score + vertices[tri[1]].score + vertices[tri[2]].score;
+		best = triangle_score[t] > triangle_score[best] ? t : best;
+	}
+
+	std::vector<unsigned int> out(triangles * 3);
+	std::vector<char> emitted(triangles, 0);
+	unsigned int cache[max_cache_size + 3], next_cache[max_cache_size + 3];
+	unsigned int cached = 0;
+	// Dead ends, where no cached vertex has triangles left, continue at the first triangle not emitted yet
+	size_t cursor = 0;
+
+	for (size_t t = 0; t < triangles; t++)
+	{
+		if (best == triangles)
+		{
+			while (emitted[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		const unsigned int* tri = indices + best * 3;
+		out[t * 3 + 0] = tri[0];
+		out[t * 3 + 1] = tri[1];
+		out[t * 3 + 2] = tri[2];
+		emitted[best] = 1;
+
+		// The triangle moves to the front of the cache, the entries pushed past its end are evicted below
+		unsigned int next = 0;
+		for (int c = 0; c < 3; c++)
+			if ((c < 1 || tri[c] != tri[0]) && (c < 2 || tri[c] != tri[1]))
+				next_cache[next++] = tri[c];
+		for (unsigned int i = 0; i < cached; i++)
+		{
+			unsigned int v = cache[i];
+			if (v != tri[0] && v != tri[1] && v != tri[2])
+				next_cache[next++] = v;
+		}
+
+		// Emitted triangles are swapped behind the live ones, once per corner as the lists hold a triangle once per corner
+		for (int c = 0; c < 3; c++)
+		{
+			VertexState& vertex = vertices[tri[c]];
+			unsigned int* list = &adjacency[vertex.first];
+			for (unsigned int k = 0; k < vertex.live; k++)
+				if (list[k] == best)
+				{
+					std::swap(list[k], list[vertex.live - 1]);
+					vertex.live--;
+					break;
+				}
+		}
+
+		// Rescore every vertex that was or is cached and pick the best live triangle around them on the way
+		// A triangle can be picked before its last vertex is rescored, which costs next to nothing and saves a second pass
+		best = triangles;
+		float best_score = 0.0f;
+		for (unsigned int i = 0; i < next; i++)
+		{
+			VertexState& vertex = vertices[next_cache[i]];
+			float score = tables.score(i < cache_size ? static_cast<int>(i) : -1, vertex.live);
+			float delta = score - vertex.score;
+			vertex.score = score;
+			const unsigned int* list = &adjacency[vertex.first];
+			for (unsigned int k = 0; k < vertex.live; k++)
+			{
+				float& triangle = triangle_score[list[k]];
+				triangle += delta;
+				if (triangle > best_score || best == triangles)
+				{
+					best = list[k];
+					best_score = triangle;
+				}
+			}
+		}
+
+		cached = next < cache_size ? next : cache_size;
+		std::copy(next_cache, next_cache + cached, cache);
+	}
+
+	std::copy(out.begin(), out.end(), indices);
+}
+
+void optimize_overdraw(unsigned int* indices, size_t index_count, const float* positions, size_t position_stride, unsigned int vertex_count, unsigned int cache_size, float threshold)
+{
+	size_t triangles = index_count / 3;
+	if (triangles < 2 || !vertex_count || !cache_size)
+		return;
+
+	// Misses of every triangle in the current order, a triangle missing all three vertices starts a new strip of the cache order
+	std::vector<size_t> loaded(vertex_count, 0);
+	size_t timestamp = cache_size + 1;
+	std::vector<unsigned char> misses(triangles, 0);
+	for (size_t t = 0; t < triangles; t++)
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = indices[t * 3 + c];
+			if (timestamp - loaded[v] > cache_size)
+			{
+				loaded[v] = timestamp++;
+				misses[t]++;
+			}
+		}
+
+	// Strips are split again wherever the part so far, simulated on its own, misses within threshold of its strip
+	// Every cluster then starts on an empty cache, so drawing the clusters in any order keeps the cache cost bounded
+	std::vector<size_t> clusters;
+	std::fill(loaded.begin(), loaded.end(), 0);
+	timestamp = cache_size + 1;
+	for (size_t first = 0; first < triangles;)
+	{
+		size_t last = first + 1;
+		size_t strip_misses = misses[first];
+		while (last < triangles && misses[last] < 3)
+			strip_misses += misses[last++];
+		double limit = static_cast<double>(strip_misses) / (last - first) * threshold;
+
+		size_t start = first, cluster_misses = 0;
+		timestamp += cache_size + 1;
+		for (size_t t = first; t < last; t++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				unsigned int v = indices[t * 3 + c];
+				if (timestamp - loaded[v] > cache_size)
+				{
+					loaded[v] = timestamp++;
+					cluster_misses++;
+				}
+			}
+			if (t + 1 < last && cluster_misses <= limit * (t + 1 - start))
+			{
+				clusters.push_back(start);
+				start = t + 1;
+				cluster_misses = 0;
+				timestamp += cache_size + 1;
+			}
+		}
+		clusters.push_back(start);
+		first = last;
+	}
+	clusters.push_back(triangles);
+	size_t cluster_count = clusters.size() - 1;
+	if (cluster_count < 2)
+		return;
+
+	// Area weighted centroid and summed normal of every cluster and of the whole mesh
+	std::vector<double> centroids(cluster_count * 3, 0.0), normals(cluster_count * 3, 0.0);
+	double mesh_center[3] = {}, mesh_area = 0.0;
+	for (size_t k = 0; k < cluster_count; k++)
+	{
+		double* centroid = &centroids[k * 3];
+		double* normal = &normals[k * 3];
+		double area = 0.0;
+		for (size_t t = clusters[k]; t < clusters[k + 1]; t++)
+		{
+			const float* p0 = positions + indices[t * 3 + 0] * position_stride;
+			const float* p1 = positions + indices[t * 3 + 1] * position_stride;
+			const float* p2 = positions + indices[t * 3 + 2] * position_stride;
+			double e1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+			double e2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+			double n[3] = { e1[1] * e2[2] - e1[2] * e2[1], e1[2] * e2[0] - e1[0] * e2[2], e1[0] * e2[1] - e1[1] * e2[0] };
+			double a = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+			for (int c = 0; c < 3; c++)
+			{
+				centroid[c] += (static_cast<double>(p0[c]) + p1[c] + p2[c]) / 3.0 * a;
+				normal[c] += n[c];
+			}
+			area += a;
+		}
+		for (int c = 0; c < 3; c++)
+		{
+			mesh_center[c] += centroid[c];
+			centroid[c] = area > 0.0 ? centroid[c] / area : 0.0;
+		}
+		mesh_area += area;
+	}
+	if (!(mesh_area > 0.0))
+		return;
+	for (int c = 0; c < 3; c++)
+		mesh_center[c] /= mesh_area;
+
+	// Clusters facing away from the center draw first, they are the ones most likely to occlude the rest
+	std::vector<double> keys(cluster_count);
+	for (size_t k = 0; k < cluster_count; k++)
+	{
+		const double* centroid = &centroids[k * 3];
+		const double* normal = &normals[k * 3];
+		double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		double dot = 0.0;
+		for (int c = 0; c < 3; c++)
+			dot += (centroid[c] - mesh_center[c]) * normal[c];
+		keys[k] = length > 0.0 ? dot / length : 0.0;
+	}
+	std::vector<size_t> order(cluster_count);
+	for (size_t k = 0; k < cluster_count; k++)
+		order[k] = k;
+	std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return keys[a] > keys[b]; });
+
+	std::vector<unsigned int> out;
+	out.reserve(triangles * 3);
+	for (size_t k : order)
+		out.insert(out.end(), indices + clusters[k] * 3, indices + clusters[k + 1] * 3);
+	std::copy(out.begin(), out.end(), indices);
+}
+
+unsigned int optimize_vertex_fetch(unsigned int* indices, size_t index_count, unsigned int vertex_count, std::vector<unsigned int>& remap)
+{
+	remap.assign(vertex_count, ~0u);
+	unsigned int used = 0;
+	for (size_t i = 0; i < index_count; i++)
+	{
+		unsigned int& target = remap[indices[i]];
+		if (target == ~0u)
+			target = used++;
+		indices[i] = target;
+	}
+	return used;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Post-transform cache efficiency of an index buffer, simulated with a FIFO cache
+struct VertexCacheStats
+{
+	// Average cache miss ratio, vertices transformed per triangle, 3 at worst and about 0.5 for large regular grids
+	double acmr = 0.0;
+	// Average transformed vertex ratio, vertices transformed per vertex used, 1 at best
+	double atvr = 0.0;
+};
+
+VertexCacheStats analyze_vertex_cache(const unsigned int* indices, size_t index_count, unsigned int vertex_count, unsigned int cache_size);
+
+// Reorders the triangles for a post-transform cache of cache_size entries, Forsyth's linear-speed greedy scoring
+// Runs in time linear in the triangle count and always gives the same order for the same input
+void optimize_vertex_cache(unsigned int* indices, size_t index_count, unsigned int vertex_count, unsigned int cache_size);
+
+// Reorders clusters of an already cache optimized index buffer so triangles facing away from the mesh center draw first
+// Clusters only split where their own miss ratio stays within threshold times that of the cache order, 1.05 keeps 5% slack
+// positions holds a position per vertex, every position_stride floats
+void optimize_overdraw(unsigned int* indices,
+					   size_t index_count,
+					   const float* positions,
+					   size_t position_stride,
+					   unsigned int vertex_count,
+					   unsigned int cache_size,
+					   float threshold);
+
+// Renumbers the vertices in the order the indices first use them, so vertex fetches walk the buffer forward
+// remap receives the new index of every old vertex, ~0u for unused ones, returns the number of vertices used
+unsigned int optimize_vertex_fetch(unsigned int* indices, size_t index_count, unsigned int vertex_count, std::vector<unsigned int>& remap);
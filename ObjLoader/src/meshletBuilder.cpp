@@ -0,0 +1,392 @@
+#include "meshletBuilder.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include "threadPool.hpp"
+
+// Triangles split into meshlets per parallel task, meshlets never span two ranges
+const size_t meshlet_range_size = 1 << 16;
+// Meshlets that get their bounds computed per parallel task
+const size_t bounds_block_size = 1 << 10;
+
+// Slot of a vertex that is not in the current meshlet
+const uint16_t no_slot = 0xFFFF;
+
+// Meshlets of one range, vertex ids are already global
+struct MeshletRange
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> vertices;
+	std::vector<unsigned char> triangles;
+};
+
+// 10 bits of each coordinate interleaved into a 30-bit Morton code
+uint32_t morton_code(float x, float y, float z)
+{
+	auto spread = [](float value)
+	{
+		uint32_t v = static_cast<uint32_t>(value < 0.0f ? 0.0f : value > 1023.0f ? 1023.0f : value);
+		v = (v | (v << 16)) & 0x030000FF;
+		v = (v | (v << 8)) & 0x0300F00F;
+		v = (v | (v << 4)) & 0x030C30C3;
+		v = (v | (v << 2)) & 0x09249249;
+		return v;
+	};
+	return spread(x) | spread(y) << 1 | spread(z) << 2;
+}
+
+// Triangles ordered by the Morton code of their centroid, equal codes keep their index order
+std::vector<unsigned int> spatial_order(const StagingArray<Position>& pos, const StagingArray<Vertex>& vertices, const unsigned int* indices, size_t triangles,
+										ThreadPool& pool, unsigned int threads)
+{
+	float min[3] = { 0.0f, 0.0f, 0.0f }, max[3] = { 0.0f, 0.0f, 0.0f };
+	for (size_t i = 0; i < vertices.size(); i++)
+	{
+		const Position& p = pos[vertices[i].position];
+		float c[3] = { p.x, p.y, p.z };
+		for (int a = 0; a < 3; a++)
+		{
+			min[a] = i == 0 || c[a] < min[a] ? c[a] : min[a];
+			max[a] = i == 0 || c[a] > max[a] ? c[a] : max[a];
+		}
+	}
+	// One scale for every axis, flat meshes still spread over the codes of their two wide axes
+	float extent = std::max(max[0] - min[0], std::max(max[1] - min[1], max[2] - min[2]));
+	float scale = extent > 0.0f ? 1023.0f / extent : 0.0f;
+
+	std::vector<uint32_t> codes(triangles);
+	size_t blocks = (triangles + meshlet_range_size - 1) / meshlet_range_size;
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * meshlet_range_size < triangles ? (b + 1) * meshlet_range_size : triangles;
+		for (size_t t = b * meshlet_range_size; t < last; t++)
+		{
+			const Position& p0 = pos[vertices[indices[t * 3 + 0]].position];
+			const Position& p1 = pos[vertices[indices[t * 3 + 1]].position];
+			const Position& p2 = pos[vertices[indices[t * 3 + 2]].position];
+			codes[t] = morton_code(((p0.x + p1.x + p2.x) / 3.0f - min[0]) * scale, ((p0.y + p1.y + p2.y) / 3.0f - min[1]) * scale,
+								   ((p0.z + p1.z + p2.z) / 3.0f - min[2]) * scale);
+		}
+	}, threads);
+
+	// Stable radix sort over three 10-bit digits
+	std::vector<unsigned int> order(triangles), sorted(triangles);
+	for (size_t t = 0; t < triangles; t++)
+		order[t] = static_cast<unsigned int>(t);
+	for (int shift = 0; shift < 30; shift += 10)
+	{
+		std::vector<size_t> offsets(1025, 0);
+		for (unsigned int t : order)
+			offsets[((codes[t] >> shift) & 1023) + 1]++;
+		for (size_t d = 0; d < 1024; d++)
+			offsets[d + 1] += offsets[d];
+		for (unsigned int t : order)
+			sorted[offsets[(codes[t] >> shift) & 1023]++] = t;
+		order.swap(sorted);
+	}
+	return order;
+}
+
+// Grows meshlets over the triangles order[0, count) with range local vertex ids
+void build_range(const unsigned int* indices, const unsigned int* order, size_t count, unsigned int max_vertices, unsigned int max_triangles, MeshletRange& range)
+{
+	// Vertices of the range numbered densely in order of first use, so the per vertex state stays small
+	// Power of two table at most half full, empty slots hold ~0 as their vertex
+	size_t capacity = 16;
+	while (capacity < count * 6)
+		capacity <<= 1;
+	std::vector<std::pair<unsigned int, unsigned int>> table(capacity, { ~0u, 0u });
+	std::vector<unsigned int> corners(count * 3), globals;
+	globals.reserve(count);
+	for (size_t i = 0; i < count * 3; i++)
+	{
+		unsigned int v = indices[static_cast<size_t>(order[i / 3]) * 3 + i % 3];
+		size_t slot = (v * 0x9E3779B97F4A7C15ull >> 32) & (capacity - 1);
+		while (table[slot].first != ~0u && table[slot].first != v)
+			slot = (slot + 1) & (capacity - 1);
+		if (table[slot].first == ~0u)
+		{
+			table[slot] = { v, static_cast<unsigned int>(globals.size()) };
+			globals.push_back(v);
+		}
+		corners[i] = table[slot].second;
+	}
+	std::vector<std::pair<unsigned int, unsigned int>>().swap(table);
+	size_t vertex_count = globals.size();
+
+	// Triangles around every vertex, the unused ones come first in its list, once per corner
+	std::vector<unsigned int> first(vertex_count + 1, 0), live(vertex_count, 0), adjacency(count * 3);
+	for (unsigned int v : corners)
+		live[v]++;
+	for (size_t v = 0; v < vertex_count; v++)
+		first[v + 1] = first[v] + live[v];
+	{
+		std::vector<unsigned int> filled(first.begin(), first.end() - 1);
+		for (size_t i = 0; i < count * 3; i++)
+			adjacency[filled[corners[i]]++] = static_cast<unsigned int>(i / 3);
+	}
+
+	std::vector<uint16_t> slot(vertex_count, no_slot);
+	std::vector<unsigned char> used(count, 0);
+	std::vector<unsigned int> current;
+	std::vector<unsigned char> micro;
+	size_t cursor = 0;
+
+	// Distinct corners of a triangle that are not in the current meshlet yet
+	auto added_vertices = [&](size_t t)
+	{
+		const unsigned int* tri = &corners[t * 3];
+		return (slot[tri[0]] == no_slot) + (slot[tri[1]] == no_slot && tri[1] != tri[0]) + (slot[tri[2]] == no_slot && tri[2] != tri[0] && tri[2] != tri[1]);
+	};
+
+	auto finish = [&]()
+	{
+		Meshlet meshlet;
+		meshlet.vertex_offset = static_cast<unsigned int>(range.vertices.size());
+		meshlet.triangle_offset = static_cast<unsigned int>(range.triangles.size());
+		meshlet.vertex_count = static_cast<unsigned int>(current.size());
+		meshlet.triangle_count = static_cast<unsigned int>(micro.size() / 3);
+		range.meshlets.push_back(meshlet);
+		for (unsigned int v : current)
+		{
+			range.vertices.push_back(globals[v]);
+			slot[v] = no_slot;
+		}
+		range.triangles.insert(range.triangles.end(), micro.begin(), micro.end());
+		range.triangles.resize((range.triangles.size() + 3) & ~size_t(3), 0);
+		current.clear();
+		micro.clear();
+	};
+
+	for (size_t emitted = 0; emitted < count; emitted++)
+	{
+		// The triangle sharing the most vertices with the meshlet that still fits, ties go to the earlier one along the curve
+		size_t best = count;
+		int best_added = 4;
+		for (unsigned int v : current)
+			for (unsigned int k = 0; k < live[v]; k++)
+			{
+				unsigned int t = adjacency[first[v] + k];
+				int added = added_vertices(t);
+				if (current.size() + added <= max_vertices && (added < best_added || (added == best_added && t < best)))
+				{
+					best = t;
+					best_added = added;
+				}
+			}
+
+		// Nothing fits or touches the meshlet, the next one starts at the first unused triangle along the curve
+		if (best == count)
+		{
+			if (!current.empty())
+				finish();
+			while (used[cursor])
+				cursor++;
+			best = cursor;
+		}
+
+		used[best] = 1;
+		for (int c = 0; c < 3; c++)
+		{
+			unsigned int v = corners[best * 3 + c];
+			unsigned int* list = &adjacency[first[v]];
+			for (unsigned int k = 0; k < live[v]; k++)
+				if (list[k] == best)
+				{
+					std::swap(list[k], list[live[v] - 1]);
+					live[v]--;
+					break;
+				}
+			if (slot[v] == no_slot)
+			{
+				slot[v] = static_cast<uint16_t>(current.size());
+				current.push_back(v);
+			}
+			micro.push_back(static_cast<unsigned char>(slot[v]));
+		}
+
+		if (micro.size() / 3 == max_triangles)
+			finish();
+	}
+	if (!current.empty())
+		finish();
+}
+
+// Bounding sphere and normal cone of one meshlet
+MeshletBounds meshlet_bounds(const StagingArray<Position>& pos, const StagingArray<Vertex>& vertices, const Meshlets& meshlets, const Meshlet& meshlet)
+{
+	MeshletBounds bounds;
+	auto point = [&](unsigned int i) -> const Position& { return pos[vertices[meshlets.vertices[meshlet.vertex_offset + i]].position]; };
+	auto distance2 = [](const Position& a, const float b[3])
+	{
+		float x = a.x - b[0], y = a.y - b[1], z = a.z - b[2];
+		return x * x + y * y + z * z;
+	};
+
+	// Ritter's sphere, started from the widest pair of axis extremes and grown over every point outside
+	auto coordinate = [](const Position& p, int a) { return a == 0 ? p.x : a == 1 ? p.y : p.z; };
+	unsigned int lo[3] = {}, hi[3] = {};
+	for (unsigned int i = 1; i < meshlet.vertex_count; i++)
+		for (int a = 0; a < 3; a++)
+		{
+			float c = coordinate(point(i), a);
+			lo[a] = c < coordinate(point(lo[a]), a) ? i : lo[a];
+			hi[a] = c > coordinate(point(hi[a]), a) ? i : hi[a];
+		}
+	int axis = 0;
+	float widest = -1.0f;
+	for (int a = 0; a < 3; a++)
+	{
+		const Position& h = point(hi[a]);
+		float c[3] = { h.x, h.y, h.z };
+		float d = distance2(point(lo[a]), c);
+		if (d > widest)
+		{
+			widest = d;
+			axis = a;
+		}
+	}
+	const Position& a0 = point(lo[axis]);
+	const Position& a1 = point(hi[axis]);
+	float center[3] = { (a0.x + a1.x) * 0.5f, (a0.y + a1.y) * 0.5f, (a0.z + a1.z) * 0.5f };
+	float radius = std::sqrt(widest) * 0.5f;
+	for (unsigned int i = 0; i < meshlet.vertex_count; i++)
+	{
+		const Position& p = point(i);
+		float d = std::sqrt(distance2(p, center));
+		if (d > radius)
+		{
+			// Move the center toward the point so the far side of the old sphere stays inside
+			float grown = (radius + d) * 0.5f;
+			float t = (grown - radius) / d;
+			center[0] += (p.x - center[0]) * t;
+			center[1] += (p.y - center[1]) * t;
+			center[2] += (p.z - center[2]) * t;
+			radius = grown;
+		}
+	}
+	for (int a = 0; a < 3; a++)
+		bounds.center[a] = center[a];
+	bounds.radius = radius;
+
+	// Normal cone over the unit normals of the triangles, degenerate triangles have no say
+	std::vector<float> normals(meshlet.triangle_count * 3, 0.0f);
+	float sum[3] = {};
+	for (unsigned int t = 0; t < meshlet.triangle_count; t++)
+	{
+		const unsigned char* tri = &meshlets.triangles[meshlet.triangle_offset + t * 3];
+		const Position& p0 = point(tri[0]);
+		const Position& p1 = point(tri[1]);
+		const Position& p2 = point(tri[2]);
+		float e1[3] = { p1.x - p0.x, p1.y - p0.y, p1.z - p0.z };
+		float e2[3] = { p2.x - p0.x, p2.y - p0.y, p2.z - p0.z };
+		float* n = &normals[t * 3];
+		n[0] = e1[1] * e2[2] - e1[2] * e2[1];
+		n[1] = e1[2] * e2[0] - e1[0] * e2[2];
+		n[2] = e1[0] * e2[1] - e1[1] * e2[0];
+		float length = std::sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]);
+		float inverse = length > 0.0f ? 1.0f / length : 0.0f;
+		for (int a = 0; a < 3; a++)
+		{
+			n[a] *= inverse;
+			sum[a] += n[a];
+		}
+	}
+	float length = std::sqrt(sum[0] * sum[0] + sum[1] * sum[1] + sum[2] * sum[2]);
+	if (!(length > 0.0f))
+		return bounds;
+	float cone[3] = { sum[0] / length, sum[1] / length, sum[2] / length };
+
+	float min_dot = 1.0f;
+	for (unsigned int t = 0; t < meshlet.triangle_count; t++)
+	{
+		const float* n = &normals[t * 3];
+		if (n[0] != 0.0f || n[1] != 0.0f || n[2] != 0.0f)
+			min_dot = std::min(min_dot, n[0] * cone[0] + n[1] * cone[1] + n[2] * cone[2]);
+	}
+	// A cone wider than about 84 degrees off its axis culls too rarely to be worth testing
+	if (min_dot <= 0.1f)
+		return bounds;
+
+	// The apex lies far enough back along the axis that every triangle plane faces away from it
+	float max_t = 0.0f;
+	for (unsigned int t = 0; t < meshlet.triangle_count; t++)
+	{
+		const float* n = &normals[t * 3];
+		float along = n[0] * cone[0] + n[1] * cone[1] + n[2] * cone[2];
+		if (along <= 0.0f)
+			continue;
+		const Position& p0 = point(meshlets.triangles[meshlet.triangle_offset + t * 3]);
+		float to_center = (center[0] - p0.x) * n[0] + (center[1] - p0.y) * n[1] + (center[2] - p0.z) * n[2];
+		max_t = std::max(max_t, to_center / along);
+	}
+	for (int a = 0; a < 3; a++)
+	{
+		bounds.cone_apex[a] = center[a] - cone[a] * max_t;
+		bounds.cone_axis[a] = cone[a];
+	}
+	bounds.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+	return bounds;
+}
+
+void build_meshlets(const StagingArray<Position>& pos, const StagingArray<Vertex>& vertices, const unsigned int* indices, size_t index_count, const MeshletOptions& options, ThreadPool& pool, unsigned int threads, Meshlets& meshlets)
+{
+	meshlets.meshlets.clear();
+	meshlets.bounds.clear();
+	meshlets.vertices.clear();
+	meshlets.triangles.clear();
+	size_t triangles = index_count / 3;
+	if (!triangles)
+		return;
+
+	unsigned int max_vertices = options.max_vertices < 3 ? 3 : options.max_vertices > 256 ? 256 : options.max_vertices;
+	unsigned int max_triangles = options.max_triangles < 1 ? 1 : options.max_triangles > 512 ? 512 : options.max_triangles;
+
+	std::vector<unsigned int> order = spatial_order(pos, vertices, indices, triangles, pool, threads);
+
+	size_t range_count = (triangles + meshlet_range_size - 1) / meshlet_range_size;
+	std::vector<MeshletRange> ranges(range_count);
+	pool.parallel_for(range_count, [&](size_t r)
+	{
+		size_t first = r * meshlet_range_size;
+		size_t count = triangles - first < meshlet_range_size ? triangles - first : meshlet_range_size;
+		build_range(indices, order.data() + first, count, max_vertices, max_triangles, ranges[r]);
+	}, threads);
+
+	// Ranges joined in order, their offsets moved past the ranges before them
+	size_t meshlet_total = 0, vertex_total = 0, triangle_total = 0;
+	for (const MeshletRange& range : ranges)
+	{
+		meshlet_total += range.meshlets.size();
+		vertex_total += range.vertices.size();
+		triangle_total += range.triangles.size();
+	}
+	meshlets.meshlets.reserve(meshlet_total);
+	meshlets.vertices.reserve(vertex_total);
+	meshlets.triangles.reserve(triangle_total);
+	for (MeshletRange& range : ranges)
+	{
+		unsigned int vertex_offset = static_cast<unsigned int>(meshlets.vertices.size());
+		unsigned int triangle_offset = static_cast<unsigned int>(meshlets.triangles.size());
+		for (Meshlet meshlet : range.meshlets)
+		{
+			meshlet.vertex_offset += vertex_offset;
+			meshlet.triangle_offset += triangle_offset;
+			meshlets.meshlets.push_back(meshlet);
+		}
+		meshlets.vertices.insert(meshlets.vertices.end(), range.vertices.begin(), range.vertices.end());
+		meshlets.triangles.insert(meshlets.triangles.end(), range.triangles.begin(), range.triangles.end());
+		range = MeshletRange();
+	}
+
+	meshlets.bounds.resize(meshlet_total);
+	size_t blocks = (meshlet_total + bounds_block_size - 1) / bounds_block_size;
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * bounds_block_size < meshlet_total ? (b + 1) * bounds_block_size : meshlet_total;
+		for (size_t m = b * bounds_block_size; m < last; m++)
+			meshlets.bounds[m] = meshlet_bounds(pos, vertices, meshlets, meshlets.meshlets[m]);
+	}, threads);
+}
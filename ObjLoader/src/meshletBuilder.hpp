@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "objMesh.hpp"
+
+class ThreadPool;
+
+// Triangles are three bytes each into the vertices of their meshlet, which index the vertex buffer
+struct Meshlet
+{
+	// First entry in Meshlets::vertices
+	unsigned int vertex_offset = 0;
+	// First byte in Meshlets::triangles, every meshlet starts on a multiple of 4
+	unsigned int triangle_offset = 0;
+	unsigned int vertex_count = 0;
+	unsigned int triangle_count = 0;
+};
+
+// Culling data of a meshlet
+// The meshlet is backfacing from camera when dot(normalize(cone_apex - camera), cone_axis) >= cone_cutoff
+struct MeshletBounds
+{
+	float center[3] = {};
+	float radius = 0.0f;
+	float cone_apex[3] = {};
+	float cone_axis[3] = {};
+	// 1 when the normals spread too far for the cone to ever cull
+	float cone_cutoff = 1.0f;
+};
+
+struct MeshletOptions
+{
+	// At most 256 vertices, as triangles index them with a byte
+	unsigned int max_vertices = 64;
+	// At most 512 triangles
+	unsigned int max_triangles = 124;
+};
+
+// Flat arrays of a meshlet mesh, ready to be uploaded as they are
+struct Meshlets
+{
+	std::vector<Meshlet> meshlets;
+	// Parallel to meshlets
+	std::vector<MeshletBounds> bounds;
+	std::vector<unsigned int> vertices;
+	// Zero padded to 4 bytes after every meshlet
+	std::vector<unsigned char> triangles;
+};
+
+// Splits an indexed mesh into meshlets, the position of vertex i is pos[vertices[i].position]
+// Triangles are sorted along a Morton curve and cut into fixed ranges, which are split in parallel
+// Meshlets grow over the triangles sharing the most vertices with them, so the output does not depend on the thread count
+void build_meshlets(const StagingArray<Position>& pos,
+					const StagingArray<Vertex>& vertices,
+					const unsigned int* indices,
+					size_t index_count,
+					const MeshletOptions& options,
+					ThreadPool& pool,
+					unsigned int threads,
+					Meshlets& meshlets);
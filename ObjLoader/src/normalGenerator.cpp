@@ -0,0 +1,159 @@
+#include "normalGenerator.hpp"
+
+#include <cmath>
+
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include "threadPool.hpp"
+
+// Faces handled per parallel task and per vectorized batch
+const size_t block_size = 1 << 14;
+const size_t batch_size = 64;
+
+// Edges and unnormalized normals of a batch of faces in structure of arrays layout
+// Only the gather is scalar, the arithmetic loops are left to the compiler to vectorize
+struct FaceBatch
+{
+	float e1x[batch_size], e1y[batch_size], e1z[batch_size];
+	float e2x[batch_size], e2y[batch_size], e2z[batch_size];
+	float nx[batch_size], ny[batch_size], nz[batch_size];
+
+	void load(const Position* pos, const Vertex* vertices, size_t first, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const Vertex* face = vertices + (first + i) * 3;
+			const Position& a = pos[face[0].position];
+			const Position& b = pos[face[1].position];
+			const Position& c = pos[face[2].position];
+			// b and c relative to a
+			e1x[i] = b.x - a.x;
+			e1y[i] = b.y - a.y;
+			e1z[i] = b.z - a.z;
+			e2x[i] = c.x - a.x;
+			e2y[i] = c.y - a.y;
+			e2z[i] = c.z - a.z;
+		}
+		for (size_t i = 0; i < count; i++)
+		{
+			nx[i] = e1y[i] * e2z[i] - e2y[i] * e1z[i];
+			ny[i] = e1z[i] * e2x[i] - e2z[i] * e1x[i];
+			nz[i] = e1x[i] * e2y[i] - e2x[i] * e1y[i];
+		}
+	}
+
+	// Same arithmetic as glm::normalize, so flat normals match the scalar version bit for bit
+	void normalize(size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			float inverse = 1.0f / std::sqrt(nx[i] * nx[i] + ny[i] * ny[i] + nz[i] * nz[i]);
+			nx[i] *= inverse;
+			ny[i] *= inverse;
+			nz[i] *= inverse;
+		}
+	}
+};
+
+// Runs fn(first, count) over batches of faces, blocks of batches are spread over the pool
+template <typename F>
+void for_each_batch(size_t faces, ThreadPool& pool, unsigned int threads, F&& fn)
+{
+	size_t blocks = (faces + block_size - 1) / block_size;
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * block_size < faces ? (b + 1) * block_size : faces;
+		for (size_t first = b * block_size; first < last; first += batch_size)
+			fn(first, last - first < batch_size ? last - first : batch_size);
+	}, threads);
+}
+
+// Angle between two edges leaving the same corner
+float corner_angle(glm::vec3 a, glm::vec3 b)
+{
+	float length = glm::length(a) * glm::length(b);
+	if (length <= 0.0f)
+		return 0.0f;
+	float cosine = glm::dot(a, b) / length;
+	return std::acos(cosine < -1.0f ? -1.0f : cosine > 1.0f ? 1.0f : cosine);
+}
+
+void generate_flat_normals(const StagingArray<Position>& pos, const StagingArray<Vertex>& vertices, StagingArray<Normal>& normals, ThreadPool& pool, unsigned int threads)
+{
+	size_t faces = vertices.size() / 3;
+	normals.resize(faces);
+	for_each_batch(faces, pool, threads, [&](size_t first, size_t count)
+	{
+		FaceBatch batch;
+		batch.load(pos.data(), vertices.data(), first, count);
+		batch.normalize(count);
+		for (size_t i = 0; i < count; i++)
+			normals[first + i] = { batch.nx[i], batch.ny[i], batch.nz[i] };
+	});
+}
+
+void generate_smooth_normals(const StagingArray<Position>& pos, const StagingArray<Vertex>& vertices, bool angle_weighted, StagingArray<Normal>& normals, ThreadPool& pool, unsigned int threads)
+{
+	size_t faces = vertices.size() / 3;
+	size_t corners = faces * 3;
+
+	// Weighted normal of every corner, the length of the cross product is twice the face area
+	std::vector<glm::vec3> weighted(corners);
+	for_each_batch(faces, pool, threads, [&](size_t first, size_t count)
+	{
+		FaceBatch batch;
+		batch.load(pos.data(), vertices.data(), first, count);
+		if (!angle_weighted)
+		{
+			for (size_t i = 0; i < count; i++)
+				for (size_t c = 0; c < 3; c++)
+					weighted[(first + i) * 3 + c] = glm::vec3(batch.nx[i], batch.ny[i], batch.nz[i]);
+			return;
+		}
+
+		batch.normalize(count);
+		for (size_t i = 0; i < count; i++)
+		{
+			glm::vec3 n(batch.nx[i], batch.ny[i], batch.nz[i]);
+			if (!(glm::dot(n, n) > 0.0f))
+				n = glm::vec3(0.0f); // Degenerate faces do not contribute
+			glm::vec3 e1(batch.e1x[i], batch.e1y[i], batch.e1z[i]);
+			glm::vec3 e2(batch.e2x[i], batch.e2y[i], batch.e2z[i]);
+			glm::vec3 e3 = e2 - e1;
+			size_t corner = (first + i) * 3;
+			weighted[corner] = n * corner_angle(e1, e2);
+			weighted[corner + 1] = n * corner_angle(-e1, e3);
+			weighted[corner + 2] = n * corner_angle(-e2, -e3);
+		}
+	});
+
+	// Corners grouped by position, filled in face order so every sum has a fixed order
+	std::vector<unsigned int> offsets(pos.size() + 1, 0);
+	for (size_t i = 0; i < corners; i++)
+		offsets[vertices[i].position + 1]++;
+	for (size_t p = 0; p < pos.size(); p++)
+		offsets[p + 1] += offsets[p];
+	std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+	std::vector<unsigned int> adjacency(corners);
+	for (size_t i = 0; i < corners; i++)
+		adjacency[cursor[vertices[i].position]++] = static_cast<unsigned int>(i);
+	cursor = std::vector<unsigned int>();
+
+	normals.resize(pos.size());
+	size_t blocks = (pos.size() + block_size - 1) / block_size;
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * block_size < pos.size() ? (b + 1) * block_size : pos.size();
+		for (size_t p = b * block_size; p < last; p++)
+		{
+			glm::vec3 sum(0.0f);
+			for (unsigned int i = offsets[p]; i < offsets[p + 1]; i++)
+				sum += weighted[adjacency[i]];
+			// Unused positions and cancelled sums keep a zero normal
+			float length = glm::length(sum);
+			glm::vec3 n = length > 0.0f ? sum / length : glm::vec3(0.0f);
+			normals[p] = { n.x, n.y, n.z };
+		}
+	}, threads);
+}
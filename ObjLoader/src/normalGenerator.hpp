@@ -0,0 +1,24 @@
+#pragma once
+
+#include <vector>
+
+#include "objMesh.hpp"
+
+class ThreadPool;
+
+// One normal per face, normals[f] belongs to the triangle vertices[3f .. 3f + 2]
+void generate_flat_normals(const StagingArray<Position>& pos,
+						   const StagingArray<Vertex>& vertices,
+						   StagingArray<Normal>& normals,
+						   ThreadPool& pool,
+						   unsigned int threads);
+
+// One normal per position, the normalized sum of the normals of every face using it
+// Faces are weighted by area, or by their angle at the position when angle_weighted is set
+// The sum per position always runs in face order, so the result does not depend on the thread count
+void generate_smooth_normals(const StagingArray<Position>& pos,
+							 const StagingArray<Vertex>& vertices,
+							 bool angle_weighted,
+							 StagingArray<Normal>& normals,
+							 ThreadPool& pool,
+							 unsigned int threads);
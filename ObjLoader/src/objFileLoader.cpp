@@ -3,269 +3,2165 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <string_view>
+#include <cstring>
 #include <vector>
-#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 
-#include <glm/vec3.hpp>
-#include <glm/geometric.hpp>
+#include "blockReader.hpp"
+#include "compressedInput.hpp"
+#include "loadMemory.hpp"
+#include "loadTrace.hpp"
+#include "mappedFile.hpp"
+#include "meshCache.hpp"
+#include "normalGenerator.hpp"
+#include "objMesh.hpp"
+#include "objTokenizer.hpp"
+#include "tangentGenerator.hpp"
+#include "threadPool.hpp"
+#include "vertexLayout.hpp"
 
-struct Position { float x, y, z; };
+// Attribute lines seen so far, including malformed ones
+struct LineCounts { unsigned int pos = 0, norm = 0, uv = 0; };
 
-struct Normal { float x, y, z; };
+// One triangle as written in the file, 1-based indices and 0 where a component is missing
+struct FaceRecord { unsigned int pos_i[3], uv_i[3], norm_i[3]; };
 
-struct UV { float x, y; };
+// Valid attribute counts in effect for the faces of a chunk from 'first' on
+struct FaceRun { size_t first; unsigned int pos, norm, uv; };
 
-struct Vertex
+// A usemtl, o or g line, the name applies from face 'first' of the chunk on
+enum class SwitchKind { Material, Object, Group };
+struct PartSwitch { size_t first; SwitchKind kind; std::string name; };
+
+// Lines of a chunk that are not attribute records
+struct LineTally { size_t lines = 0, faces = 0, skipped = 0, malformed = 0, filtered = 0; };
+
+// Everything parsed from one newline aligned slice of the file
+// Its arrays live in the arena of the state, or in its upstream resource for the chunks an incremental load keeps
+struct Chunk
+{
+	explicit Chunk(std::pmr::memory_resource* memory) : pos(memory), normals(memory), uvs(memory), faces(memory), runs(memory), parsed_faces(memory) {}
+
+	StagingArray<Position> pos;
+	StagingArray<Normal> normals;
+	StagingArray<UV> uvs;
+	StagingArray<FaceRecord> faces;
+	StagingArray<FaceRun> runs;
+	std::vector<PartSwitch> switches;
+	// Files named by mtllib lines
+	std::vector<std::string> libraries;
+	LineCounts counts;
+	// Lines seen before the first face of the chunk
+	LineCounts first_face_counts;
+	LineTally tally;
+	bool has_face = false;
+	// Only with a filter, the names in effect and whether their faces are skipped
+	const SubmeshFilter* filter = nullptr;
+	std::string object, group;
+	bool skip_faces = false;
+	LoadProgress* progress = nullptr;
+	// Set when the merge dropped faces of the chunk, which then no longer holds what its bytes parse to
+	bool compacted = false;
+	// Faces and part switches as parsed, saved by an incremental merge before it drops any
+	// A face dropped in this load may be valid in the next, where the chunk lands at other offsets
+	StagingArray<FaceRecord> parsed_faces;
+	std::vector<PartSwitch> parsed_switches;
+
+	// Empties the chunk, its arrays keep their capacity in the arena
+	void reset()
+	{
+		pos.clear();
+		normals.clear();
+		uvs.clear();
+		faces.clear();
+		runs.clear();
+		switches.clear();
+		libraries.clear();
+		counts = first_face_counts = LineCounts();
+		tally = LineTally();
+		has_face = false;
+		filter = nullptr;
+		object.clear();
+		group.clear();
+		skip_faces = false;
+		progress = nullptr;
+		compacted = false;
+		parsed_faces.clear();
+		parsed_switches.clear();
+	}
+};
+
+// Parse state of one load, kept by its context so the memory of its arena carries over to the next load
+struct LoadContext::State
+{
+	explicit State(std::pmr::memory_resource* upstream)
+		: arena(upstream), vertices(&arena), pos(&arena), normals(&arena), uvs(&arena), generated(&arena), tangents(&arena) {}
+
+	// Every staging array of the state and its chunks, emptied at once when the next load starts
+	Arena arena;
+
+	// Byte sizes of the attributes in the output, 0 when absent
+	unsigned int position_size = 0, normal_size = 0, uv_size = 0;
+
+	StagingArray<Vertex> vertices;
+	StagingArray<Position> pos;
+	StagingArray<Normal> normals;
+	StagingArray<UV> uvs;
+	// Normals made when the file brings none, per face or per position depending on the mode
+	StagingArray<Normal> generated;
+	// Per UV, only for formats with tangents
+	StagingArray<TangentSum> tangents;
+	NormalMode normal_mode = NormalMode::Flat;
+	VertexFormat format = VertexFormat::Auto;
+	bool sort_materials = true;
+	std::vector<Chunk> chunks;
+	// Set for an incremental load, whose chunks hash their bytes and are kept for the next one
+	bool incremental = false;
+	std::vector<uint64_t> chunk_hashes;
+	// Chunks of the last incremental load with the hashes of their bytes, outside of the arena so they outlive its rewind
+	std::vector<Chunk> kept;
+	std::vector<uint64_t> kept_hashes;
+
+	// Material names by id in order of first use, and the staged vertices of each, faces without material last
+	std::vector<std::string> material_names;
+	std::vector<MaterialRange> material_ranges;
+	// Object and group names by id in order of their first face, and the staged vertices of each in output order
+	std::vector<Submesh> submesh_names;
+	std::vector<SubmeshRange> submesh_ranges;
+	std::vector<std::string> libraries;
+
+	ThreadPool* pool = nullptr;
+	unsigned int threads = 1;
+
+	// Set by every load, spans are timed from origin and nothing is measured without stats
+	LoadStats* stats = nullptr;
+	std::chrono::steady_clock::time_point origin;
+	// Output arrays allocated by this load
+	size_t allocations = 0;
+	// Where the output arrays come from, null for the new[] arrays of the raw loads
+	std::pmr::memory_resource* output = nullptr;
+
+	// Auto only uses file normals together with UVs, the other formats whenever the file has them
+	bool generated_normals() const { return normal_size == 0 || (format == VertexFormat::Auto && uv_size == 0); }
+
+	// Auto resolved against the attributes of the file
+	VertexFormat output_format() const
+	{
+		if (format != VertexFormat::Auto)
+			return format;
+		return uv_size > 0 ? VertexFormat::PositionNormalUV : VertexFormat::PositionNormal;
+	}
+
+	// Chunks are created with their arrays in the arena
+	void resize_chunks(size_t count)
+	{
+		while (chunks.size() > count)
+			chunks.pop_back();
+		while (chunks.size() < count)
+			chunks.emplace_back(&arena);
+	}
+
+	// Drops every staging array and rewinds the arena, which keeps its memory for this load
+	void reset()
+	{
+		position_size = normal_size = uv_size = 0;
+		vertices = StagingArray<Vertex>(&arena);
+		pos = StagingArray<Position>(&arena);
+		normals = StagingArray<Normal>(&arena);
+		uvs = StagingArray<UV>(&arena);
+		generated = StagingArray<Normal>(&arena);
+		tangents = StagingArray<TangentSum>(&arena);
+		chunks.clear();
+		chunk_hashes.clear();
+		arena.rewind();
+		material_names.clear();
+		material_ranges.clear();
+		submesh_names.clear();
+		submesh_ranges.clear();
+		libraries.clear();
+		allocations = 0;
+	}
+
+	// Empties the state and gives the memory of the arena back, for loads that will not finish
+	void free_staging()
+	{
+		reset();
+		std::vector<Chunk>().swap(chunks);
+		drop_kept();
+		arena.release();
+	}
+
+	void drop_kept()
+	{
+		std::vector<Chunk>().swap(kept);
+		kept_hashes.clear();
+	}
+
+	// The chunks of an incremental load become the ones the next load matches against
+	// Compacted chunks get their parsed faces back, the next merge checks them again where the chunk lands
+	void keep_chunks()
+	{
+		drop_kept();
+		for (size_t i = 0; i < chunks.size(); i++)
+		{
+			Chunk& chunk = chunks[i];
+			if (chunk.compacted)
+			{
+				chunk.faces.swap(chunk.parsed_faces);
+				chunk.switches.swap(chunk.parsed_switches);
+				chunk.parsed_faces.clear();
+				chunk.parsed_switches.clear();
+				chunk.compacted = false;
+			}
+			kept.push_back(std::move(chunk));
+			kept_hashes.push_back(chunk_hashes[i]);
+		}
+		chunks.clear();
+	}
+};
+
+using State = LoadContext::State;
+
+void count_records(std::string_view text, LineCounts& counts, size_t& faces);
+
+// Records of a slice counted on windows spread over it and scaled to its size, a little over the count when the lines are alike
+void estimate_records(std::string_view text, LineCounts& counts, size_t& faces);
+
+// Bytes parsed between progress updates and cancellation checks
+const size_t progress_step = 1 << 16;
+
+// Blocks of a pipelined read or of decompressed input, and the reads kept in flight ahead of the parse
+const size_t pipeline_block_size = 8 << 20;
+const unsigned int pipeline_reads = 2;
+
+void parse_chunk(std::string_view text, Chunk& chunk, bool prepass);
+
+void parse_line(std::string_view line, Chunk& chunk);
+
+void start_submesh(Chunk& chunk, const SubmeshFilter& filter, std::string_view object, std::string_view group);
+
+// Last o and g names of a slice, has_* is false for a kind the slice has no line of
+struct SubmeshNames { std::string_view object, group; bool has_object = false, has_group = false; };
+
+void scan_submesh_names(std::string_view text, SubmeshNames& names);
+
+// False when the face cannot be read
+bool parse_face(Tokenizer& tokens, Chunk& chunk);
+
+std::vector<std::string_view> split_chunks(std::string_view text, size_t count);
+
+// Newline aligned slices whose ends only depend on the bytes just before them, for incremental loads
+std::vector<std::string_view> split_content(std::string_view text, ThreadPool& pool, unsigned int threads);
+
+bool resolve_layout(State& state);
+
+void merge_chunks(State& state);
+
+bool check_face(const State& state, const FaceRecord& face, const FaceRun& limits);
+
+// Output sizes of a format, taken from its compile-time layout
+struct FormatInfo { unsigned int stride = 0, position_size = 0, normal_size = 0, uv_size = 0, tangent_size = 0; };
+
+FormatInfo format_info(VertexFormat format);
+
+void output_sizes(const State& state, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size);
+
+unsigned int out_stride(const State& state);
+
+VertexSources output_sources(const State& state, const StagingArray<Position>& pos, const StagingArray<Normal>& normals, const StagingArray<UV>& uvs);
+
+float* make_out_array(State& state, unsigned int count);
+
+// Writes count staged vertices as interleaved floats
+void write_vertices(const State& state, const Vertex* vertices, size_t count, const VertexSources& sources, float* out);
+
+unsigned int* make_index_array(State& state, unsigned int count);
+
+void optimize_indexed(State& state, unsigned int* indices, unsigned int index_count, const LoadOptions& options, LoadStats* stats);
+
+void collect_parts(const State& state, const char* path, MeshParts& parts);
+
+// Starts the measurements of a load, stats may be null
+void begin_stats(State& state, LoadStats* stats, std::chrono::steady_clock::time_point origin);
+
+// Raises the peak staging memory to what the arena handed out plus extra bytes held outside of it
+// Also publishes the allocations counted so far, so the last call of a load leaves the final count
+void track_staging(State& state, size_t extra = 0);
+
+// Counts of the parse, taken once the chunks are merged
+void collect_stats(State& state, size_t parsed_faces);
+
+// True once the caller asked the load to stop
+bool cancelled(const LoadOptions& options)
+{
+	return options.progress && options.progress->cancel;
+}
+
+// Parses the file through a BlockReader into one chunk per block, false when it could not be read
+bool parse_pipelined(State& state, const char* path, const LoadOptions& options);
+
+// Same through a DecompressReader, for compressed files whatever the options ask for
+bool parse_compressed(State& state, const char* path, const LoadOptions& options, Compression compression);
+
+// Parses the blocks of a source in parallel into the chunks of the state, returns the bytes parsed
+size_t parse_blocks(State& state, BlockSource& source, const LoadOptions& options);
+
+// Maps the file and parses the chunks whose bytes the kept chunks do not match, false when it could not be read
+bool parse_incremental(State& state, const char* path, const LoadOptions& options);
+
+// Parses the file into the context state, false when it could not be read or the load was cancelled
+bool parse_object(State& state, const char* path, const LoadOptions& options)
+{
+	// Nothing from a previous load may leak into this one
+	state.reset();
+	std::vector<Chunk>& chunks = state.chunks;
+
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int threads = options.threads ? options.threads : pool.size() + 1;
+	state.pool = &pool;
+	state.threads = threads;
+	state.normal_mode = options.normals;
+	state.format = options.format;
+	state.sort_materials = options.materials;
+
+	LoadStats* stats = state.stats;
+	Compression compression = detect_compression(path);
+	// Kept chunks are only matched by the next incremental load, any other load drops them
+	state.incremental = options.incremental && options.memory_map && !options.filter && compression == Compression::None;
+	if (!state.incremental)
+		state.drop_kept();
+	if (compression != Compression::None)
+	{
+		if (!parse_compressed(state, path, options, compression))
+			return false;
+	}
+	else if (state.incremental)
+	{
+		if (!parse_incremental(state, path, options))
+			return false;
+	}
+	else if (options.pipeline)
+	{
+		if (!parse_pipelined(state, path, options))
+			return false;
+	}
+	else if (options.memory_map)
+	{
+		PhaseTimer read_timer(stats, LoadPhase::Read, state.origin);
+		MappedFile file(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+			return false;
+		}
+		read_timer.stop();
+		if (stats)
+			stats->bytes = file.size();
+		if (options.progress)
+			options.progress->total = file.size();
+
+		// A few chunks per thread evens out slices that are heavier to parse
+		const size_t min_chunk_size = 1 << 20;
+		size_t chunk_count = threads > 1 ? file.size() / min_chunk_size : 1;
+		if (chunk_count > threads * 4)
+			chunk_count = threads * 4;
+		std::vector<std::string_view> slices = split_chunks(file.view(), chunk_count ? chunk_count : 1);
+
+		PhaseTimer parse_timer(stats, LoadPhase::Parse, state.origin);
+		state.resize_chunks(slices.size());
+		for (auto&& chunk : chunks)
+		{
+			chunk.reset();
+			chunk.progress = options.progress;
+		}
+		if (options.filter && !slices.empty())
+		{
+			// A chunk only skips faces once it knows the names in effect, which the slices before it set
+			std::vector<SubmeshNames> names(slices.size());
+			pool.parallel_for(slices.size() - 1, [&](size_t i) { scan_submesh_names(slices[i], names[i]); }, threads);
+			SubmeshNames current;
+			for (size_t i = 0; i < slices.size(); i++)
+			{
+				start_submesh(chunks[i], options.filter, current.object, current.group);
+				current.object = names[i].has_object ? names[i].object : current.object;
+				current.group = names[i].has_group ? names[i].group : current.group;
+			}
+		}
+		if (!stats)
+			pool.parallel_for(slices.size(), [&](size_t i) { parse_chunk(slices[i], chunks[i], options.prepass); }, threads);
+		else
+		{
+			// Every chunk gets a lane of its own, so the trace shows how evenly the pool was loaded
+			std::vector<LoadSpan> spans(slices.size());
+			pool.parallel_for(slices.size(), [&](size_t i)
+			{
+				auto start = std::chrono::steady_clock::now();
+				parse_chunk(slices[i], chunks[i], options.prepass);
+				auto end = std::chrono::steady_clock::now();
+				spans[i].phase = LoadPhase::Parse;
+				spans[i].lane = static_cast<unsigned int>(i + 1);
+				spans[i].start_ms = std::chrono::duration<double, std::milli>(start - state.origin).count();
+				spans[i].wall_ms = std::chrono::duration<double, std::milli>(end - start).count();
+			}, threads);
+			stats->spans.insert(stats->spans.end(), spans.begin(), spans.end());
+		}
+	}
+	else
+	{
+		PhaseTimer read_timer(stats, LoadPhase::Read, state.origin);
+		std::ifstream file;
+		file.open(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+			return false;
+		}
+		read_timer.stop();
+		LoadProgress* progress = options.progress;
+		if (progress)
+		{
+			std::error_code error;
+			progress->total = static_cast<size_t>(std::filesystem::file_size(path, error));
+		}
+
+		// Reading and parsing interleave line by line, both count as parsing
+		PhaseTimer parse_timer(stats, LoadPhase::Parse, state.origin);
+		state.resize_chunks(1);
+		chunks[0].reset();
+		if (options.filter)
+			start_submesh(chunks[0], options.filter, {}, {});
+		std::string line;
+		size_t bytes = 0, reported = 0;
+		while (std::getline(file, line))
+		{
+			bytes += line.size() + 1;
+			parse_line(line, chunks[0]);
+			if (progress && bytes - reported >= progress_step)
+			{
+				progress->bytes += bytes - reported;
+				reported = bytes;
+				if (progress->cancel)
+					break;
+			}
+		}
+		if (progress)
+			progress->bytes += bytes - reported;
+		if (stats)
+			stats->bytes = bytes;
+	}
+
+	if (cancelled(options))
+	{
+		state.free_staging();
+		return false;
+	}
+
+	size_t parsed_faces = 0;
+	for (const Chunk& chunk : chunks)
+		parsed_faces += chunk.faces.size();
+	track_staging(state);
+
+	if (resolve_layout(state))
+		merge_chunks(state);
+	collect_stats(state, parsed_faces);
+	if (cancelled(options))
+	{
+		state.free_staging();
+		return false;
+	}
+	if (state.incremental)
+		state.keep_chunks();
+	return true;
+}
+
+// Threads hashing the source and the payload of a cache
+unsigned int cache_threads(const LoadOptions& options)
+{
+	return options.threads ? options.threads : ThreadPool::shared().size() + 1;
+}
+
+// Key of the cache for this load, false when caching is off or the source cannot be read
+bool cache_key(const char* path, bool indexed, const LoadOptions& options, CacheKey& key)
+{
+	// A filter cannot be compared between loads
+	if (!options.cache_path || options.filter)
+		return false;
+
+	ThreadPool& pool = ThreadPool::shared();
+	unsigned int threads = cache_threads(options);
+	// Every option that changes the output arrays is hashed into the layout, each one whole
+	uint64_t fields[7] = { indexed, static_cast<uint64_t>(options.normals), static_cast<uint64_t>(options.format), options.materials };
+	if (indexed && options.optimize != MeshOptimization::None)
+	{
+		fields[4] = static_cast<uint64_t>(options.optimize);
+		fields[5] = options.vertex_cache_size;
+		// The threshold only matters for overdraw
+		if (options.optimize == MeshOptimization::Overdraw)
+		{
+			uint32_t threshold;
+			memcpy(&threshold, &options.overdraw_threshold, sizeof(threshold));
+			fields[6] = threshold;
+		}
+	}
+	uint64_t layout = hash_block(reinterpret_cast<const char*>(fields), sizeof(fields));
+	return make_cache_key(path, layout, pool, threads, key);
+}
+
+// Output arrays are new[] arrays the caller owns, unless the load fills a Mesh and they come from its resource
+template <typename T>
+T* allocate_output(const State& state, size_t count)
+{
+	if (!state.output)
+		return new T[count];
+	return static_cast<T*>(state.output->allocate(count * sizeof(T), alignof(T)));
+}
+
+template <typename T>
+void free_output(const State& state, T* data, size_t count)
+{
+	if (!state.output)
+		delete[] data;
+	else if (data)
+		state.output->deallocate(data, count * sizeof(T), alignof(T));
+}
+
+// Copy of a mapped cache payload in an output array
+template <typename T>
+T* copy_array(const State& state, const T* data, size_t count)
+{
+	if (!count)
+		return nullptr;
+	T* out = allocate_output<T>(state, count);
+	memcpy(out, data, count * sizeof(T));
+	return out;
+}
+
+LoadContext::LoadContext(std::pmr::memory_resource* upstream) : m_state(std::make_unique<State>(upstream)) {}
+
+LoadContext::~LoadContext() = default;
+
+LoadContext::LoadContext(LoadContext&&) noexcept = default;
+
+LoadContext& LoadContext::operator=(LoadContext&&) noexcept = default;
+
+void LoadContext::release()
+{
+	m_state = std::make_unique<State>(m_state->arena.upstream());
+}
+
+float* LoadContext::load(const char* path, unsigned int& count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, const LoadOptions& options, MeshParts* parts, LoadStats* stats)
+{
+	// count			=		number of vertices
+	// position_size	=		byte size of a position
+	// normal_size		=		byte size of a normal
+	// uv_size			=		byte size of a UV
+
+	LoadTimer timer(stats);
+	PhaseTimer cache_timer(options.cache_path ? stats : nullptr, LoadPhase::Cache, timer.origin());
+	CacheKey key;
+	bool cached = !parts && cache_key(path, false, options, key);
+	CachedMesh mesh;
+	if (cached && read_cache(options.cache_path, key, ThreadPool::shared(), cache_threads(options), mesh))
+	{
+		position_size = mesh.payload.position_size;
+		normal_size = mesh.payload.normal_size;
+		uv_size = mesh.payload.uv_size;
+		count = mesh.payload.vertex_count;
+		return copy_array(*m_state, mesh.payload.vertices, static_cast<size_t>(count) * mesh.payload.stride);
+	}
+	cache_timer.stop();
+
+	State& state = *m_state;
+	begin_stats(state, stats, timer.origin());
+	if (!parse_object(state, path, options))
+		return nullptr;
+
+	output_sizes(state, position_size, normal_size, uv_size);
+	count = state.vertices.size();
+	if (parts)
+		collect_parts(state, path, *parts);
+
+	float* out = count ? make_out_array(state, count) : nullptr;
+	if (cached)
+	{
+		// Missing, stale or damaged, rebuilt from this parse
+		PhaseTimer write_timer(stats, LoadPhase::Cache, timer.origin());
+		CachePayload payload;
+		payload.vertices = out;
+		payload.vertex_count = count;
+		payload.stride = out_stride(state);
+		payload.position_size = position_size;
+		payload.normal_size = normal_size;
+		payload.uv_size = uv_size;
+		write_cache(options.cache_path, key, payload, ThreadPool::shared(), cache_threads(options));
+	}
+	return out;
+}
+
+float* LoadContext::load_indexed(const char* path, unsigned int& count, unsigned int*& indices, unsigned int& index_count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, const LoadOptions& options, LoadStats* stats, MeshParts* parts)
+{
+	// count			=		number of unique vertices
+	// index_count		=		number of indices, 3 per triangle
+
+	indices = nullptr;
+	LoadTimer timer(stats);
+	PhaseTimer cache_timer(options.cache_path ? stats : nullptr, LoadPhase::Cache, timer.origin());
+	CacheKey key;
+	bool cached = !parts && cache_key(path, true, options, key);
+	CachedMesh mesh;
+	if (cached && read_cache(options.cache_path, key, ThreadPool::shared(), cache_threads(options), mesh))
+	{
+		position_size = mesh.payload.position_size;
+		normal_size = mesh.payload.normal_size;
+		uv_size = mesh.payload.uv_size;
+		count = mesh.payload.vertex_count;
+		index_count = mesh.payload.index_count;
+		if (stats)
+		{
+			stats->referenced_vertices = index_count;
+			stats->unique_vertices = count;
+			stats->dedup_ratio = count ? static_cast<double>(index_count) / count : 0.0;
+			stats->dedup_ms = 0.0;
+			if (options.optimize != MeshOptimization::None)
+			{
+				stats->cache_before = stats->cache_after = analyze_vertex_cache(mesh.payload.indices, index_count, count, options.vertex_cache_size);
+				stats->optimize_ms = 0.0;
+			}
+		}
+		if (!count)
+			return nullptr;
+		indices = copy_array(*m_state, mesh.payload.indices, index_count);
+		return copy_array(*m_state, mesh.payload.vertices, static_cast<size_t>(count) * mesh.payload.stride);
+	}
+	cache_timer.stop();
+
+	State& state = *m_state;
+	begin_stats(state, stats, timer.origin());
+	if (!parse_object(state, path, options))
+		return nullptr;
+
+	output_sizes(state, position_size, normal_size, uv_size);
+	index_count = state.vertices.size();
+	indices = make_index_array(state, index_count);
+	count = state.vertices.size();
+
+	if (stats)
+	{
+		stats->referenced_vertices = index_count;
+		stats->unique_vertices = count;
+		stats->dedup_ratio = count ? static_cast<double>(index_count) / count : 0.0;
+		stats->dedup_ms = stats->wall_ms[static_cast<unsigned int>(LoadPhase::Dedup)];
+	}
+	if (options.optimize != MeshOptimization::None)
+		optimize_indexed(state, indices, index_count, options, stats);
+	// Indices stay in the order of the staged vertices, so the ranges carry over
+	if (parts)
+		collect_parts(state, path, *parts);
+
+	float* out = count ? make_out_array(state, count) : nullptr;
+	if (cached)
+	{
+		PhaseTimer write_timer(stats, LoadPhase::Cache, timer.origin());
+		CachePayload payload;
+		payload.vertices = out;
+		payload.indices = indices;
+		payload.vertex_count = count;
+		payload.index_count = index_count;
+		payload.stride = out_stride(state);
+		payload.position_size = position_size;
+		payload.normal_size = normal_size;
+		payload.uv_size = uv_size;
+		write_cache(options.cache_path, key, payload, ThreadPool::shared(), cache_threads(options));
+	}
+	if (out)
+		return out;
+	free_output(state, indices, index_count);
+	indices = nullptr;
+	return nullptr;
+}
+
+bool LoadContext::load_mesh(const char* path, Mesh& mesh, bool indexed, const LoadOptions& options, MeshParts* parts, LoadStats* stats)
+{
+	mesh = Mesh();
+	std::pmr::memory_resource* resource = options.memory ? options.memory : std::pmr::get_default_resource();
+
+	// The raw loads allocate from the resource while the mesh is loaded, also when they fail
+	struct OutputScope
+	{
+		State& state;
+		~OutputScope() { state.output = nullptr; }
+	} scope{ *m_state };
+	m_state->output = resource;
+
+	unsigned int* indices = nullptr;
+	float* vertices = indexed
+		? load_indexed(path, mesh.count, indices, mesh.index_count, mesh.position_size, mesh.normal_size, mesh.uv_size, options, stats, parts)
+		: load(path, mesh.count, mesh.position_size, mesh.normal_size, mesh.uv_size, options, parts, stats);
+	if (!vertices)
+		return false;
+
+	mesh.stride = options.format == VertexFormat::Auto ? mesh.position_size + mesh.normal_size + mesh.uv_size : vertex_stride(options.format);
+	mesh.vertices = OutputArray<float>(vertices, static_cast<size_t>(mesh.count) * mesh.stride / sizeof(float), resource);
+	if (indices)
+		mesh.indices = OutputArray<unsigned int>(indices, mesh.index_count, resource);
+	return true;
+}
+
+unsigned char* LoadContext::load_packed(const char* path, unsigned int& count, unsigned int*& indices, unsigned int& index_count, Dequantization& dequantization, const PackOptions& pack, const LoadOptions& options)
+{
+	count = index_count = 0;
+	indices = nullptr;
+	dequantization = Dequantization();
+	State& state = *m_state;
+	begin_stats(state, nullptr, std::chrono::steady_clock::now());
+	if (!parse_object(state, path, options) || state.vertices.empty())
+		return nullptr;
+
+	count = state.vertices.size();
+	if (pack.indexed)
+	{
+		index_count = count;
+		indices = make_index_array(state, index_count);
+		count = state.vertices.size();
+		if (options.optimize != MeshOptimization::None)
+			optimize_indexed(state, indices, index_count, options, nullptr);
+	}
+
+	FormatInfo info = format_info(state.output_format());
+	VertexSources sources = output_sources(state, state.pos, state.normals, state.uvs);
+	return pack_vertices(state.pos, state.vertices.data(), count, sources.normals, sources.uvs, info.normal_size > 0, info.uv_size > 0, pack.normals,
+						 *state.pool, state.threads, dequantization);
+}
+
+float* LoadContext::load_meshlets(const char* path, unsigned int& count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, Meshlets& meshlets, const MeshletOptions& meshlet_options, const LoadOptions& options)
+{
+	count = 0;
+	meshlets = Meshlets();
+	State& state = *m_state;
+	begin_stats(state, nullptr, std::chrono::steady_clock::now());
+	if (!parse_object(state, path, options))
+		return nullptr;
+
+	output_sizes(state, position_size, normal_size, uv_size);
+	unsigned int index_count = state.vertices.size();
+	if (!index_count)
+		return nullptr;
+
+	unsigned int* indices = make_index_array(state, index_count);
+	build_meshlets(state.pos, state.vertices, indices, index_count, meshlet_options, *state.pool, state.threads, meshlets);
+	free_output(state, indices, index_count);
+
+	// Merged vertices are all used by some meshlet, so the remap is a permutation
+	std::vector<unsigned int> remap;
+	count = state.vertices.size();
+	optimize_vertex_fetch(meshlets.vertices.data(), meshlets.vertices.size(), count, remap);
+	StagingArray<Vertex> fetched(count, &state.arena);
+	for (unsigned int i = 0; i < count; i++)
+		fetched[remap[i]] = state.vertices[i];
+	state.vertices.swap(fetched);
+
+	return make_out_array(state, count);
+}
+
+// Serial parse of a streamed load, faces become finished vertices as soon as they are read
+// Only the current batch is staged, its normals are indexed by face within the batch
+struct BatchStream
+{
+	State& state;
+	Chunk& chunk;
+	const VertexSink& sink;
+	size_t batch_size;
+	std::vector<float> out;
+	unsigned int emitted = 0;
+	bool resolved = false;
+	bool stopped = false;
+
+	BatchStream(State& state, const VertexSink& sink, size_t batch_size)
+		: state(state), chunk(state.chunks[0]), sink(sink), batch_size(batch_size) {}
+
+	// False once the layout is invalid or the sink stopped the load
+	bool line(std::string_view text)
+	{
+		parse_line(text, chunk);
+		if (chunk.faces.empty())
+			return true;
+
+		// The layout is fixed by the attributes before the first face, exactly like a full load
+		if (!resolved)
+		{
+			if (!resolve_layout(state))
+				return false;
+			resolved = true;
+		}
+
+		FormatInfo info = format_info(state.output_format());
+		bool generated = state.generated_normals();
+		bool has_normal = info.normal_size > 0;
+		bool has_uv = state.uv_size > 0 && info.uv_size > 0;
+		const FaceRun& limits = chunk.runs.back();
+		for (const FaceRecord& face : chunk.faces)
+		{
+			if (!check_face(state, face, limits))
+				continue;
+			unsigned int face_index = static_cast<unsigned int>(state.vertices.size() / 3);
+			for (int c = 0; c < 3; c++)
+				state.vertices.push_back({ face.pos_i[c] - 1, !has_normal ? 0 : generated ? face_index : face.norm_i[c] - 1, has_uv ? face.uv_i[c] - 1 : 0 });
+		}
+		chunk.faces.clear();
+		chunk.runs.clear();
+		chunk.switches.clear();
+
+		if (state.vertices.size() + 3 > batch_size)
+			flush();
+		return !stopped;
+	}
+
+	void flush()
+	{
+		if (state.vertices.empty() || stopped)
+			return;
+
+		FormatInfo info = format_info(state.output_format());
+		if (state.generated_normals() && info.normal_size > 0)
+			generate_flat_normals(chunk.pos, state.vertices, state.generated, *state.pool, state.threads);
+		out.resize(state.vertices.size() * out_stride(state));
+		write_vertices(state, state.vertices.data(), state.vertices.size(), output_sources(state, chunk.pos, chunk.normals, chunk.uvs), out.data());
+
+		VertexBatch batch;
+		batch.vertices = out.data();
+		batch.count = static_cast<unsigned int>(state.vertices.size());
+		batch.first = emitted;
+		output_sizes(state, batch.position_size, batch.normal_size, batch.uv_size);
+		emitted += batch.count;
+		state.vertices.clear();
+		stopped = !sink(batch);
+	}
+};
+
+bool LoadContext::stream(const char* path, unsigned int batch_size, const VertexSink& sink, unsigned int& count, const LoadOptions& options)
+{
+	// batch_size		=		most vertices per batch, rounded down to whole triangles
+
+	count = 0;
+	if (format_info(options.format).tangent_size > 0)
+	{
+		// Like smooth normals, tangents sum over every face of the mesh
+		std::cout << "ERROR :: Tangents cannot be streamed, \"" << path << "\" needs a full load" << std::endl;
+		return false;
+	}
+
+	State& state = *m_state;
+	state.reset();
+	begin_stats(state, nullptr, std::chrono::steady_clock::now());
+	ThreadPool& pool = ThreadPool::shared();
+	state.pool = &pool;
+	state.threads = options.threads ? options.threads : pool.size() + 1;
+	state.normal_mode = NormalMode::Flat;
+	state.format = options.format;
+	state.resize_chunks(1);
+	state.chunks[0].reset();
+	if (options.filter)
+		start_submesh(state.chunks[0], options.filter, {}, {});
+
+	BatchStream stream(state, sink, batch_size < 3 ? 3 : batch_size - batch_size % 3);
+	state.vertices.reserve(stream.batch_size);
+
+	Compression compression = detect_compression(path);
+	if (compression != Compression::None)
+	{
+		if (!compression_supported(compression))
+		{
+			std::cout << "ERROR :: File \"" << path << "\" is " << compression_name(compression) << " compressed, which this build cannot read" << std::endl;
+			return false;
+		}
+		DecompressReader reader(path, compression, pipeline_block_size, 2, false, state.origin);
+		if (!reader.is_open())
+		{
+			std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+			return false;
+		}
+
+		// Lines crossing a block boundary are joined in carry
+		std::string carry;
+		size_t index;
+		bool open = true;
+		for (std::string_view block = reader.next(index); open && !block.empty(); block = reader.next(index))
+		{
+			for (size_t end = block.find('\n'); open && end != std::string_view::npos; end = block.find('\n'))
+			{
+				if (carry.empty())
+					open = stream.line(block.substr(0, end));
+				else
+				{
+					carry.append(block.substr(0, end));
+					open = stream.line(carry);
+					carry.clear();
+				}
+				block.remove_prefix(end + 1);
+			}
+			carry.append(block);
+			reader.release(index);
+		}
+		if (reader.failed())
+			return false;
+		if (open && !carry.empty())
+			stream.line(carry);
+	}
+	else if (options.memory_map)
+	{
+		MappedFile file(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+			return false;
+		}
+
+		if (options.prepass)
+		{
+			// Faces are never held, so only the attribute arrays are sized up front
+			LineCounts records;
+			size_t faces = 0;
+			count_records(file.view(), records, faces);
+			state.chunks[0].pos.reserve(records.pos);
+			state.chunks[0].normals.reserve(records.norm);
+			state.chunks[0].uvs.reserve(records.uv);
+		}
+
+		const char* it = file.data();
+		const char* end = it + file.size();
+		while (it != end)
+		{
+			const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+			if (!eol)
+				eol = end;
+			if (!stream.line(std::string_view(it, eol - it)))
+				break;
+			it = eol == end ? end : eol + 1;
+		}
+	}
+	else
+	{
+		std::ifstream file;
+		file.open(path);
+		if (!file.is_open())
+		{
+			std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+			return false;
+		}
+
+		std::string line;
+		while (std::getline(file, line))
+			if (!stream.line(line))
+				break;
+	}
+
+	stream.flush();
+	count = stream.emitted;
+	return true;
+}
+
+float* loadObject(const char* path, unsigned int& count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, const LoadOptions& options, MeshParts* parts, LoadStats* stats)
+{
+	LoadContext context(options.memory);
+	return context.load(path, count, position_size, normal_size, uv_size, options, parts, stats);
+}
+
+float* loadIndexedObject(const char* path, unsigned int& count, unsigned int*& indices, unsigned int& index_count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, const LoadOptions& options, LoadStats* stats, MeshParts* parts)
+{
+	LoadContext context(options.memory);
+	return context.load_indexed(path, count, indices, index_count, position_size, normal_size, uv_size, options, stats, parts);
+}
+
+Mesh loadMesh(const char* path, bool indexed, const LoadOptions& options, MeshParts* parts, LoadStats* stats)
+{
+	LoadContext context(options.memory);
+	Mesh mesh;
+	context.load_mesh(path, mesh, indexed, options, parts, stats);
+	return mesh;
+}
+
+unsigned char* loadPackedObject(const char* path, unsigned int& count, unsigned int*& indices, unsigned int& index_count, Dequantization& dequantization, const PackOptions& pack, const LoadOptions& options)
+{
+	LoadContext context(options.memory);
+	return context.load_packed(path, count, indices, index_count, dequantization, pack, options);
+}
+
+float* loadMeshletObject(const char* path, unsigned int& count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size, Meshlets& meshlets, const MeshletOptions& meshlet_options, const LoadOptions& options)
+{
+	LoadContext context(options.memory);
+	return context.load_meshlets(path, count, position_size, normal_size, uv_size, meshlets, meshlet_options, options);
+}
+
+bool streamObject(const char* path, unsigned int batch_size, const VertexSink& sink, unsigned int& count, const LoadOptions& options)
+{
+	LoadContext context(options.memory);
+	return context.stream(path, batch_size, sink, count, options);
+}
+
+std::vector<std::string_view> split_chunks(std::string_view text, size_t count)
+{
+	std::vector<std::string_view> slices;
+	size_t begin = 0;
+	for (size_t i = 1; i <= count && begin < text.size(); i++)
+	{
+		// Every slice but the last ends just past a newline
+		size_t end = text.size();
+		if (i < count)
+		{
+			end = text.find('\n', text.size() / count * i > begin ? text.size() / count * i : begin);
+			end = end == std::string_view::npos ? text.size() : end + 1;
+		}
+		slices.push_back(text.substr(begin, end - begin));
+		begin = end;
+	}
+	return slices;
+}
+
+// A newline ends a slice when the top bits of the hash of the bytes before it are 0, about every 32768 lines
+// Slices also have a minimum size, so a file of short lines is not cut too finely
+const int content_cut_bits = 15;
+const size_t content_cut_window = 16;
+const size_t content_min_slice = 256 << 10;
+
+std::vector<std::string_view> split_content(std::string_view text, ThreadPool& pool, unsigned int threads)
+{
+	// A cut only depends on the 16 bytes before its newline, so the regions can look for them in parallel
+	size_t regions = threads ? threads : 1;
+	std::vector<std::vector<size_t>> cuts(regions);
+	pool.parallel_for(regions, [&](size_t r)
+	{
+		size_t first = text.size() / regions * r;
+		size_t last = r + 1 < regions ? text.size() / regions * (r + 1) : text.size();
+		const char* data = text.data();
+		for (const char* found = static_cast<const char*>(memchr(data + first, '\n', last - first)); found;
+			 found = static_cast<const char*>(memchr(found + 1, '\n', data + last - found - 1)))
+		{
+			size_t end = found - data;
+			size_t start = end > content_cut_window ? end - content_cut_window : 0;
+			uint64_t words[2] = {};
+			memcpy(words, data + start, end - start);
+			uint64_t h = (words[0] * 0x9E3779B97F4A7C15ull) ^ (words[1] * 0xC2B2AE3D27D4EB4Full);
+			h ^= h >> 29;
+			h *= 0xBF58476D1CE4E5B9ull;
+			if ((h >> (64 - content_cut_bits)) == 0)
+				cuts[r].push_back(end + 1);
+		}
+	}, threads);
+
+	// Cuts too close to the one before are skipped, past an edit both versions keep the same cuts again from the first one they share
+	std::vector<std::string_view> slices;
+	size_t begin = 0;
+	for (const auto& region : cuts)
+		for (size_t cut : region)
+			if (cut - begin >= content_min_slice)
+			{
+				slices.push_back(text.substr(begin, cut - begin));
+				begin = cut;
+			}
+	if (begin < text.size())
+		slices.push_back(text.substr(begin));
+	return slices;
+}
+
+bool parse_incremental(State& state, const char* path, const LoadOptions& options)
+{
+	LoadStats* stats = state.stats;
+	ThreadPool& pool = *state.pool;
+	unsigned int threads = state.threads;
+	PhaseTimer read_timer(stats, LoadPhase::Read, state.origin);
+	MappedFile file(path);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+		return false;
+	}
+	read_timer.stop();
+	if (stats)
+		stats->bytes = file.size();
+	if (options.progress)
+		options.progress->total = file.size();
+
+	// Cutting and hashing read every byte once, which is far cheaper than parsing it and counts as parsing
+	PhaseTimer parse_timer(stats, LoadPhase::Parse, state.origin);
+	std::vector<std::string_view> slices = split_content(file.view(), pool, threads);
+	std::vector<uint64_t>& hashes = state.chunk_hashes;
+	hashes.resize(slices.size());
+	pool.parallel_for(slices.size(), [&](size_t i) { hashes[i] = hash_block(slices[i].data(), slices[i].size()); }, threads);
+
+	// A kept chunk with the same bytes holds what they parse to, whatever moved around it
+	// Only its face indices depend on the chunks before it, and the merge links them again through its prefix sums
+	std::unordered_multimap<uint64_t, size_t> previous;
+	for (size_t i = 0; i < state.kept.size(); i++)
+		previous.emplace(state.kept_hashes[i], i);
+	std::vector<size_t> changed;
+	size_t reused = 0;
+	for (size_t i = 0; i < slices.size(); i++)
+	{
+		auto found = previous.find(hashes[i]);
+		if (found != previous.end())
+		{
+			state.chunks.push_back(std::move(state.kept[found->second]));
+			previous.erase(found);
+			reused += slices[i].size();
+			continue;
+		}
+		state.chunks.emplace_back(state.arena.upstream());
+		state.chunks.back().progress = options.progress;
+		changed.push_back(i);
+	}
+	state.drop_kept();
+	if (stats)
+		stats->reused_bytes = reused;
+	if (options.progress)
+		options.progress->bytes += reused;
+
+	std::vector<LoadSpan> spans(stats ? changed.size() : 0);
+	pool.parallel_for(changed.size(), [&](size_t c)
+	{
+		size_t i = changed[c];
+		auto start = std::chrono::steady_clock::now();
+		parse_chunk(slices[i], state.chunks[i], options.prepass);
+		if (!stats)
+			return;
+		spans[c].phase = LoadPhase::Parse;
+		spans[c].lane = static_cast<unsigned int>(c + 1);
+		spans[c].start_ms = std::chrono::duration<double, std::milli>(start - state.origin).count();
+		spans[c].wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+	}, threads);
+	if (stats)
+		stats->spans.insert(stats->spans.end(), spans.begin(), spans.end());
+	return true;
+}
+
+void count_records(std::string_view text, LineCounts& counts, size_t& faces)
+{
+	// Only the head of every line is looked at, memchr does the wide scan for the line ends
+	const char* it = text.data();
+	const char* end = it + text.size();
+	while (it != end)
+	{
+		while (it != end && Tokenizer::is_space(*it))
+			it++;
+		if (end - it >= 2)
+		{
+			char next = it[1];
+			bool single = Tokenizer::is_space(next);
+			if (it[0] == 'v')
+			{
+				counts.pos += single;
+				counts.norm += next == 'n';
+				counts.uv += next == 't';
+			}
+			else if (it[0] == 'f')
+				faces += single;
+		}
+
+		const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+		it = eol ? eol + 1 : end;
+	}
+}
+
+void estimate_records(std::string_view text, LineCounts& counts, size_t& faces)
 {
-	Position* position;
-	Normal* normal;
-	UV* uv;
-};
+	const size_t windows = 64;
+	const size_t window_size = 4 << 10;
+	if (text.size() <= windows * window_size)
+	{
+		count_records(text, counts, faces);
+		return;
+	}
+
+	// Every window starts on a line of its own, the line it cut is left to the window before
+	LineCounts sampled;
+	size_t sampled_faces = 0, sampled_bytes = 0;
+	size_t stride = text.size() / windows;
+	for (size_t w = 0; w < windows; w++)
+	{
+		size_t begin = w * stride;
+		if (begin > 0)
+		{
+			size_t eol = text.find('\n', begin - 1);
+			begin = eol == std::string_view::npos ? text.size() : eol + 1;
+		}
+		size_t size = std::min(window_size, text.size() - begin);
+		count_records(text.substr(begin, size), sampled, sampled_faces);
+		sampled_bytes += size;
+	}
+	if (!sampled_bytes)
+		return;
+
+	// An eighth more covers the spread of the windows, an array that still outgrows it takes another block
+	auto scale = [&](size_t count) { count = count * text.size() / sampled_bytes; return count + count / 8; };
+	counts.pos = static_cast<unsigned int>(scale(sampled.pos));
+	counts.norm = static_cast<unsigned int>(scale(sampled.norm));
+	counts.uv = static_cast<unsigned int>(scale(sampled.uv));
+	faces = scale(sampled_faces);
+}
 
-unsigned int g_count = 0, g_position_size = 0, g_normal_size = 0, g_uv_size = 0;
+bool parse_pipelined(State& state, const char* path, const LoadOptions& options)
+{
+	LoadStats* stats = state.stats;
+	PhaseTimer read_timer(stats, LoadPhase::Read, state.origin);
+	// Every parsing thread holds one block, the readers fill the others
+	BlockReader reader(path, pipeline_block_size, state.threads + pipeline_reads, pipeline_reads);
+	if (!reader.is_open())
+	{
+		std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+		return false;
+	}
+	read_timer.stop();
+	if (stats)
+		stats->bytes = reader.size();
+	if (options.progress)
+		options.progress->total = reader.size();
 
-std::queue<Vertex> vertices;
-std::vector<Position> pos;
-std::vector<Normal> normals;
-std::vector<UV> uvs;
+	// Reads, parses and the waits for either overlap, all of it counts as parsing
+	PhaseTimer parse_timer(stats, LoadPhase::Parse, state.origin);
+	parse_blocks(state, reader, options);
+	if (reader.failed())
+	{
+		std::cout << "ERROR :: File \"" << path << "\" could not be read" << std::endl;
+		return false;
+	}
+	return true;
+}
 
-void parse_face(std::string line);
+bool parse_compressed(State& state, const char* path, const LoadOptions& options, Compression compression)
+{
+	if (!compression_supported(compression))
+	{
+		std::cout << "ERROR :: File \"" << path << "\" is " << compression_name(compression) << " compressed, which this build cannot read" << std::endl;
+		return false;
+	}
 
-float* make_out_array(unsigned int count);
+	LoadStats* stats = state.stats;
+	PhaseTimer read_timer(stats, LoadPhase::Read, state.origin);
+	DecompressReader reader(path, compression, pipeline_block_size, state.threads + pipeline_reads, stats != nullptr, state.origin);
+	if (!reader.is_open())
+	{
+		std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+		return false;
+	}
+	read_timer.stop();
+	// Progress counts the parsed text, so its total is the decompressed size when the file stores it
+	if (options.progress)
+		options.progress->total = reader.expected_size();
 
-Normal* generate_normals(Vertex face[3]);
+	PhaseTimer parse_timer(stats, LoadPhase::Parse, state.origin);
+	size_t bytes = parse_blocks(state, reader, options);
+	if (reader.failed())
+		return false;
+	parse_timer.stop();
+	if (stats && !cancelled(options))
+	{
+		// The decompression thread gets a lane after the parsing ones, its busy time is the phase
+		stats->bytes = bytes;
+		stats->compressed_bytes = reader.compressed_size();
+		for (LoadSpan span : reader.spans())
+		{
+			span.lane = state.threads + 1;
+			stats->wall_ms[static_cast<unsigned int>(LoadPhase::Decompress)] += span.wall_ms;
+			stats->cpu_ms[static_cast<unsigned int>(LoadPhase::Decompress)] += span.cpu_ms;
+			stats->spans.push_back(span);
+		}
+	}
+	return true;
+}
 
-float* loadObject(const char* path, unsigned int& count, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size)
+size_t parse_blocks(State& state, BlockSource& source, const LoadOptions& options)
 {
-	// count			=		number of vertices
-	// position_size	=		byte size of a position
-	// normal_size		=		byte size of a normal
-	// uv_size			=		byte size of a UV
+	LoadStats* stats = state.stats;
+	unsigned int threads = state.threads;
 
-	// Resulting vertices
-	float* out_vertices = nullptr;
+	// One chunk per block, created as the blocks come in, a deque keeps the ones being parsed in place
+	// The line after the last newline gets a chunk of its own at the end
+	std::deque<Chunk> parsed;
 
-	std::ifstream file;
-	file.open(path);
-	if (file.is_open())
+	// A line crossing a block boundary is parsed by the chunk of the block it ends in, from a copy
+	// Taking a block and cutting it into lines happens in file order under the lock, only the parse runs in parallel
+	std::mutex order;
+	std::string carry;
+	std::deque<std::string> heads;
+	std::string object, group;
+	std::vector<LoadSpan> spans;
+	size_t bytes = 0;
+	auto take_block = [&](Chunk*& chunk, std::string*& head, std::string_view& body, size_t& index) -> bool
 	{
-		const unsigned int n = 128;
-		unsigned int count_pos = 0, count_norm = 0, count_uv = 0;
-		while (!file.eof())
+		std::lock_guard<std::mutex> lock(order);
+		for (;;)
 		{
-			std::string line;
-			std::getline(file, line);
+			if (cancelled(options))
+				return false;
+			std::string_view block = source.next(index);
+			if (block.empty())
+				return false;
+			bytes += block.size();
 
-			char head[n]{};
-			int res = sscanf_s(line.c_str(), "%s", head, n);
-			if (0 == strcmp(head, "#") || res == 0)
+			size_t first_end = block.find('\n');
+			if (first_end == std::string_view::npos)
 			{
-				// Comment or blank line, go next
-			}
-			else if (0 == strcmp(head, "v"))
-			{		// Vertex position found
-				count_pos++;
-				Position tmp;
-				if (4 == sscanf_s(line.c_str(), "%s%f %f %f", head, n, &tmp.x, &tmp.y, &tmp.z))
-					pos.push_back(tmp);
-			}
-			else if (0 == strcmp(head, "vn"))
-			{		// Vertex normal found
-				count_norm++;
-				Normal tmp;
-				if (4 == sscanf_s(line.c_str(), "%s%f %f %f", head, n, &tmp.x, &tmp.y, &tmp.z))
-					normals.push_back(tmp);
+				// All of the block is inside one line
+				carry.append(block);
+				source.release(index);
+				continue;
 			}
-			else if (0 == strcmp(head, "vt"))
-			{		// Vertex uv found
-				count_uv++;
-				UV tmp;
-				if (3 == sscanf_s(line.c_str(), "%s%f %f", head, n, &tmp.x, &tmp.y))
-					uvs.push_back(tmp);
-			}
-			else if (0 == strcmp(head, "f"))
-			{		// Face found
-				// Check stride for position, normal and uv
-				if (!(g_position_size | g_normal_size | g_uv_size))
+			size_t last_end = block.rfind('\n');
+			chunk = &parsed.emplace_back(&state.arena);
+			chunk->progress = options.progress;
+			heads.emplace_back(std::move(carry));
+			head = &heads.back();
+			head->append(block.substr(0, first_end + 1));
+			body = block.substr(first_end + 1, last_end - first_end);
+			carry.assign(block.substr(last_end + 1));
+
+			if (options.filter)
+			{
+				// Names in effect where the chunk starts, then the ones it leaves for the next
+				start_submesh(*chunk, options.filter, object, group);
+				for (std::string_view text : { std::string_view(*head), body })
 				{
-					if (count_pos != pos.size() || count_norm != normals.size() || count_uv != uvs.size())
-						break;
-					g_position_size = sizeof(pos[0]);
-					g_normal_size = normals.size() > 0 ? sizeof(normals[0]) : 0;
-					g_uv_size = uvs.size() > 0 ? sizeof(uvs[0]) : 0;
+					SubmeshNames names;
+					scan_submesh_names(text, names);
+					if (names.has_object)
+						object = std::string(names.object);
+					if (names.has_group)
+						group = std::string(names.group);
 				}
-				parse_face(line);
 			}
+			return true;
+		}
+	};
+
+	state.pool->parallel_for(threads, [&](size_t lane)
+	{
+		Chunk* chunk;
+		std::string* head;
+		std::string_view body;
+		size_t index;
+		while (take_block(chunk, head, body, index))
+		{
+			auto start = std::chrono::steady_clock::now();
+			parse_chunk(*head, *chunk, false);
+			parse_chunk(body, *chunk, false);
+			source.release(index);
+			std::string().swap(*head);
+			if (!stats)
+				continue;
+			LoadSpan span;
+			span.phase = LoadPhase::Parse;
+			span.lane = static_cast<unsigned int>(lane + 1);
+			span.start_ms = std::chrono::duration<double, std::milli>(start - state.origin).count();
+			span.wall_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			std::lock_guard<std::mutex> lock(order);
+			spans.push_back(span);
 		}
+	}, threads);
+
+	if (!cancelled(options) && !source.failed())
+	{
+		Chunk& last = parsed.emplace_back(&state.arena);
+		last.progress = options.progress;
+		if (options.filter)
+			start_submesh(last, options.filter, object, group);
+		parse_chunk(carry, last, false);
 	}
+	if (stats)
+		stats->spans.insert(stats->spans.end(), spans.begin(), spans.end());
+
+	// The chunks move into the state, their arrays share its arena and are not copied
+	for (auto&& chunk : parsed)
+		state.chunks.push_back(std::move(chunk));
+	return bytes;
+}
+
+void parse_chunk(std::string_view text, Chunk& chunk, bool prepass)
+{
+	// Exact capacity up front with the prepass, so no array grows while parsing
+	// Without it the capacity is estimated, as an array growing in the arena keeps every storage it outgrew
+	LineCounts records;
+	size_t faces = 0;
+	if (prepass)
+		count_records(text, records, faces);
 	else
+		estimate_records(text, records, faces);
+	chunk.pos.reserve(records.pos);
+	chunk.normals.reserve(records.norm);
+	chunk.uvs.reserve(records.uv);
+	chunk.faces.reserve(faces);
+
+	// Walk the bytes line by line, every line is parsed in place
+	const char* it = text.data();
+	const char* end = it + text.size();
+	const char* reported = it;
+	while (it != end)
 	{
-		std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
-		return nullptr;
+		const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+		if (!eol)
+			eol = end;
+		parse_line(std::string_view(it, eol - it), chunk);
+		it = eol == end ? end : eol + 1;
+		if (chunk.progress && static_cast<size_t>(it - reported) >= progress_step)
+		{
+			chunk.progress->bytes += it - reported;
+			reported = it;
+			if (chunk.progress->cancel)
+				return;
+		}
+	}
+	if (chunk.progress)
+		chunk.progress->bytes += it - reported;
+}
+
+void parse_line(std::string_view line, Chunk& chunk)
+{
+	Tokenizer tokens(line);
+	std::string_view head = tokens.next_token();
+	LineTally& tally = chunk.tally;
+	tally.lines++;
+	if (head.empty() || head[0] == '#')
+	{		// Comment or blank line, go next
+		tally.skipped++;
+	}
+	else if (head == "v")
+	{		// Vertex position found
+		chunk.counts.pos++;
+		Position tmp;
+		if (tokens.parse_float(tmp.x) && tokens.parse_float(tmp.y) && tokens.parse_float(tmp.z))
+			chunk.pos.push_back(tmp);
+		else
+			tally.malformed++;
+	}
+	else if (head == "vn")
+	{		// Vertex normal found
+		chunk.counts.norm++;
+		Normal tmp;
+		if (tokens.parse_float(tmp.x) && tokens.parse_float(tmp.y) && tokens.parse_float(tmp.z))
+			chunk.normals.push_back(tmp);
+		else
+			tally.malformed++;
 	}
+	else if (head == "vt")
+	{		// Vertex uv found
+		chunk.counts.uv++;
+		UV tmp;
+		if (tokens.parse_float(tmp.x) && tokens.parse_float(tmp.y))
+			chunk.uvs.push_back(tmp);
+		else
+			tally.malformed++;
+	}
+	else if (head == "f")
+	{		// Face found, unless its submesh is filtered out it is parsed
+		tally.faces++;
+		if (chunk.skip_faces)
+		{
+			tally.filtered++;
+			return;
+		}
+		if (!chunk.has_face)
+		{
+			chunk.has_face = true;
+			chunk.first_face_counts = chunk.counts;
+		}
+		if (!parse_face(tokens, chunk))
+			tally.malformed++;
+	}
+	else if (head == "usemtl")
+	{		// Material switch found, the name may contain spaces
+		chunk.switches.push_back({ chunk.faces.size(), SwitchKind::Material, std::string(tokens.rest()) });
+	}
+	else if (head == "o" || head == "g")
+	{		// Object or group found, the name may contain spaces
+		SwitchKind kind = head == "o" ? SwitchKind::Object : SwitchKind::Group;
+		chunk.switches.push_back({ chunk.faces.size(), kind, std::string(tokens.rest()) });
+		if (chunk.filter)
+		{
+			if (kind == SwitchKind::Object)
+				chunk.group.clear();
+			(kind == SwitchKind::Object ? chunk.object : chunk.group) = chunk.switches.back().name;
+			chunk.skip_faces = !(*chunk.filter)(chunk.object, chunk.group);
+		}
+	}
+	else if (head == "mtllib")
+	{		// Material libraries found
+		for (std::string_view name = tokens.next_token(); !name.empty(); name = tokens.next_token())
+			chunk.libraries.emplace_back(name);
+	}
+	else
+	{		// Smoothing groups, lines, points and anything else the loader does not use
+		tally.skipped++;
+	}
+}
+
+void start_submesh(Chunk& chunk, const SubmeshFilter& filter, std::string_view object, std::string_view group)
+{
+	chunk.filter = &filter;
+	chunk.object = object;
+	chunk.group = group;
+	chunk.skip_faces = !filter(object, group);
+}
 
-	position_size = g_position_size;
-	normal_size = g_position_size;
-	uv_size = g_uv_size;
-	count = vertices.size();
+void scan_submesh_names(std::string_view text, SubmeshNames& names)
+{
+	// Same head only walk as count_records, the names are read with the rules of parse_line
+	const char* it = text.data();
+	const char* end = it + text.size();
+	while (it != end)
+	{
+		while (it != end && Tokenizer::is_space(*it))
+			it++;
+		const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+		if (!eol)
+			eol = end;
+		if (eol - it >= 1 && (it[0] == 'o' || it[0] == 'g') && (eol - it == 1 || Tokenizer::is_space(it[1])))
+		{
+			std::string_view name = Tokenizer(std::string_view(it + 1, eol - it - 1)).rest();
+			if (it[0] == 'o')
+			{
+				names.object = name;
+				names.group = std::string_view();
+				names.has_object = names.has_group = true;
+			}
+			else
+			{
+				names.group = name;
+				names.has_group = true;
+			}
+		}
+		it = eol == end ? end : eol + 1;
+	}
+}
 
-	if (count)
-		return make_out_array(count);
-	return nullptr;
+SubmeshFilter select_submeshes(std::vector<std::string> names)
+{
+	std::sort(names.begin(), names.end());
+	return [names = std::move(names)](std::string_view object, std::string_view group)
+	{
+		auto listed = [&](std::string_view name) { return std::binary_search(names.begin(), names.end(), name, std::less<>()); };
+		return listed(object) || listed(group);
+	};
+}
+
+bool resolve_layout(State& state)
+{
+	// Check stride for position, normal and uv against everything before the first face
+	LineCounts seen, valid;
+	for (auto&& chunk : state.chunks)
+	{
+		if (!chunk.has_face)
+		{
+			seen.pos += chunk.counts.pos;
+			seen.norm += chunk.counts.norm;
+			seen.uv += chunk.counts.uv;
+			valid.pos += static_cast<unsigned int>(chunk.pos.size());
+			valid.norm += static_cast<unsigned int>(chunk.normals.size());
+			valid.uv += static_cast<unsigned int>(chunk.uvs.size());
+			continue;
+		}
+
+		// The first run of a chunk starts at its first face
+		seen.pos += chunk.first_face_counts.pos;
+		seen.norm += chunk.first_face_counts.norm;
+		seen.uv += chunk.first_face_counts.uv;
+		valid.pos += chunk.runs.empty() ? 0 : chunk.runs[0].pos;
+		valid.norm += chunk.runs.empty() ? 0 : chunk.runs[0].norm;
+		valid.uv += chunk.runs.empty() ? 0 : chunk.runs[0].uv;
+		if (seen.pos != valid.pos || seen.norm != valid.norm || seen.uv != valid.uv)
+			return false;
+		state.position_size = sizeof(Position);
+		state.normal_size = valid.norm > 0 ? sizeof(Normal) : 0;
+		state.uv_size = valid.uv > 0 ? sizeof(UV) : 0;
+		return true;
+	}
+	return false;
 }
 
-float* make_out_array(unsigned int count)
+// Kept faces [first, last) of a chunk, the output face they start at and the parts they belong to
+struct FaceSpan { size_t first, last, target; unsigned int material, submesh; };
+
+// Stable counting sort of the faces by material id, every chunk then writes its spans in parallel
+// Ids follow the first usemtl of each name in file order, so the order never depends on the chunking
+std::vector<std::vector<FaceSpan>> place_faces(State& state, const std::vector<size_t>& kept)
 {
-	// Stride in floats
-	// Normals are generated if not present
-	unsigned int stride = g_position_size / sizeof(float) + g_position_size / sizeof(float) + g_uv_size / sizeof(float);
+	std::vector<Chunk>& chunks = state.chunks;
+	for (auto&& chunk : chunks)
+		state.libraries.insert(state.libraries.end(), chunk.libraries.begin(), chunk.libraries.end());
+
+	// Part runs of every chunk, a chunk starts with the material and names the previous one ended on
+	// Submeshes get an id per name pair as they are switched to, renumbered below by their first kept face
+	struct PartRun { size_t first; unsigned int material, submesh; };
+	std::vector<std::vector<PartRun>> runs(chunks.size());
+	std::unordered_map<std::string, unsigned int> ids, submesh_ids;
+	std::vector<Submesh> declared;
+	unsigned int current = no_material, submesh = 0;
+	std::string object, group;
+	submesh_ids.emplace("\n", 0);
+	declared.push_back(Submesh());
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		runs[i].push_back({ 0, current, submesh });
+		for (const PartSwitch& part : chunks[i].switches)
+		{
+			if (part.kind == SwitchKind::Material)
+			{
+				if (!state.sort_materials)
+					continue;
+				auto found = ids.emplace(part.name, static_cast<unsigned int>(state.material_names.size()));
+				if (found.second)
+					state.material_names.push_back(part.name);
+				current = found.first->second;
+			}
+			else
+			{
+				// An o line also ends the group, names never hold a newline so it separates them in the key
+				if (part.kind == SwitchKind::Object)
+					group.clear();
+				(part.kind == SwitchKind::Object ? object : group) = part.name;
+				auto found = submesh_ids.emplace(object + '\n' + group, static_cast<unsigned int>(declared.size()));
+				if (found.second)
+					declared.push_back({ object, group });
+				submesh = found.first->second;
+			}
+			if (runs[i].back().first == part.first)
+			{
+				runs[i].back().material = current;
+				runs[i].back().submesh = submesh;
+			}
+			else
+				runs[i].push_back({ part.first, current, submesh });
+		}
+	}
+
+	// Faces without material sort after every named one
+	size_t materials = state.material_names.size() + 1;
+	auto slot = [&](unsigned int material) { return material == no_material ? materials - 1 : material; };
+	std::vector<size_t> counts(chunks.size() * materials, 0);
+	std::vector<unsigned int> renumber(declared.size(), ~0u);
+	for (size_t i = 0; i < chunks.size(); i++)
+		for (size_t r = 0; r < runs[i].size(); r++)
+		{
+			size_t last = r + 1 < runs[i].size() ? runs[i][r + 1].first : kept[i];
+			counts[i * materials + slot(runs[i][r].material)] += last - runs[i][r].first;
+			unsigned int& id = renumber[runs[i][r].submesh];
+			if (last > runs[i][r].first && id == ~0u)
+			{
+				id = static_cast<unsigned int>(state.submesh_names.size());
+				state.submesh_names.push_back(declared[runs[i][r].submesh]);
+			}
+		}
 
-	float* out = new float[count * stride];
-	unsigned int i = 0;
-	if (stride == 8)
+	// Material major prefix sums, each chunk writes its faces of a material after those of the chunks before it
+	std::vector<size_t> cursor(chunks.size() * materials);
+	size_t total = 0;
+	for (size_t m = 0; m < materials; m++)
 	{
-		for (Vertex v; !vertices.empty(); vertices.pop(), i += stride)
+		size_t first = total;
+		for (size_t i = 0; i < chunks.size(); i++)
 		{
-			v = vertices.front();
-			// Out position
-			out[i] = v.position->x;
-			out[i + 1] = v.position->y;
-			out[i + 2] = v.position->z;
-			// Out normal
-			out[i + 3] = v.normal->x;
-			out[i + 4] = v.normal->y;
-			out[i + 5] = v.normal->z;
-			// Out UV
-			out[i + 6] = v.uv->x;
-			out[i + 7] = v.uv->y;
+			cursor[i * materials + m] = total;
+			total += counts[i * materials + m];
 		}
+		if (total > first)
+			state.material_ranges.push_back({ m + 1 == materials ? no_material : static_cast<unsigned int>(m), static_cast<unsigned int>(first * 3),
+											  static_cast<unsigned int>((total - first) * 3) });
+	}
+
+	std::vector<std::vector<FaceSpan>> spans(chunks.size());
+	std::vector<FaceSpan> placed;
+	for (size_t i = 0; i < chunks.size(); i++)
+		for (size_t r = 0; r < runs[i].size(); r++)
+		{
+			size_t first = runs[i][r].first;
+			size_t last = r + 1 < runs[i].size() ? runs[i][r + 1].first : kept[i];
+			if (first == last)
+				continue;
+			size_t& target = cursor[i * materials + slot(runs[i][r].material)];
+			spans[i].push_back({ first, last, target, runs[i][r].material, renumber[runs[i][r].submesh] });
+			placed.push_back(spans[i].back());
+			target += last - first;
+		}
+
+	// The spans tile the output, in output order neighbours of the same parts join into one range
+	std::sort(placed.begin(), placed.end(), [](const FaceSpan& a, const FaceSpan& b) { return a.target < b.target; });
+	for (const FaceSpan& span : placed)
+	{
+		unsigned int count = static_cast<unsigned int>((span.last - span.first) * 3);
+		SubmeshRange* previous = state.submesh_ranges.empty() ? nullptr : &state.submesh_ranges.back();
+		if (previous && previous->submesh == span.submesh && previous->material == span.material)
+			previous->count += count;
+		else
+			state.submesh_ranges.push_back({ span.submesh, span.material, static_cast<unsigned int>(span.target * 3), count });
+	}
+	return spans;
+}
+
+void merge_chunks(State& state)
+{
+	std::vector<Chunk>& chunks = state.chunks;
+	ThreadPool& pool = *state.pool;
+	unsigned int threads = state.threads;
+	PhaseTimer merge_timer(state.stats, LoadPhase::Merge, state.origin);
+
+	// Prefix sums place every chunk's attributes in the merged arrays
+	std::vector<LineCounts> base(chunks.size());
+	LineCounts total;
+	for (size_t i = 0; i < chunks.size(); i++)
+	{
+		base[i] = total;
+		total.pos += static_cast<unsigned int>(chunks[i].pos.size());
+		total.norm += static_cast<unsigned int>(chunks[i].normals.size());
+		total.uv += static_cast<unsigned int>(chunks[i].uvs.size());
+	}
+	if (chunks.size() == 1 && !state.incremental)
+	{
+		// A single chunk already holds the merged arrays, swapping avoids a second copy at peak
+		// Chunks kept for the next load have to stay whole and live in another resource
+		state.pos.swap(chunks[0].pos);
+		state.normals.swap(chunks[0].normals);
+		state.uvs.swap(chunks[0].uvs);
+	}
+	else
+	{
+		state.pos.resize(total.pos);
+		state.normals.resize(total.norm);
+		state.uvs.resize(total.uv);
+		pool.parallel_for(chunks.size(), [&](size_t i)
+		{
+			Chunk& chunk = chunks[i];
+			std::copy(chunk.pos.begin(), chunk.pos.end(), state.pos.begin() + base[i].pos);
+			std::copy(chunk.normals.begin(), chunk.normals.end(), state.normals.begin() + base[i].norm);
+			std::copy(chunk.uvs.begin(), chunk.uvs.end(), state.uvs.begin() + base[i].uv);
+		}, threads);
 	}
-	else if (stride == 6)
+
+	// Drop faces using attributes declared after them, compacting every chunk in place
+	// Part switches move along to the first face kept after them
+	std::vector<size_t> kept(chunks.size());
+	pool.parallel_for(chunks.size(), [&](size_t i)
+	{
+		Chunk& chunk = chunks[i];
+		size_t count = 0, next_switch = 0;
+		for (size_t r = 0; r < chunk.runs.size(); r++)
+		{
+			FaceRun limits = chunk.runs[r];
+			limits.pos += base[i].pos;
+			limits.norm += base[i].norm;
+			limits.uv += base[i].uv;
+			size_t last = r + 1 < chunk.runs.size() ? chunk.runs[r + 1].first : chunk.faces.size();
+			for (size_t f = limits.first; f < last; f++)
+			{
+				for (; next_switch < chunk.switches.size() && chunk.switches[next_switch].first <= f; next_switch++)
+					chunk.switches[next_switch].first = count;
+				if (check_face(state, chunk.faces[f], limits))
+					chunk.faces[count++] = chunk.faces[f];
+				else if (state.incremental && count == f)
+				{
+					// Nothing moved yet, the chunk is kept as parsed
+					chunk.parsed_faces.assign(chunk.faces.begin(), chunk.faces.end());
+					chunk.parsed_switches = chunk.switches;
+				}
+			}
+		}
+		for (; next_switch < chunk.switches.size(); next_switch++)
+			chunk.switches[next_switch].first = count;
+		kept[i] = count;
+		chunk.compacted = count < chunk.faces.size();
+	}, threads);
+
+	// Where the kept faces of every chunk go, grouped by material when sorting
+	std::vector<std::vector<FaceSpan>> spans = place_faces(state, kept);
+	size_t faces = 0;
+	for (size_t k : kept)
+		faces += k;
+
+	// Stage every corner as an index triplet at its final place
+	// Attributes the format leaves out are staged as 0, so indexed output merges vertices differing only in them
+	FormatInfo info = format_info(state.output_format());
+	bool generated = state.generated_normals();
+	bool flat = state.normal_mode == NormalMode::Flat;
+	bool has_normal = info.normal_size > 0;
+	bool has_uv = state.uv_size > 0 && info.uv_size > 0;
+	state.vertices.resize(faces * 3);
+	pool.parallel_for(chunks.size(), [&](size_t i)
 	{
-		for (Vertex v; !vertices.empty(); vertices.pop(), i += stride)
+		const Chunk& chunk = chunks[i];
+		for (const FaceSpan& span : spans[i])
 		{
-			v = vertices.front();
-			// Out position
-			out[i] = v.position->x;
-			out[i + 1] = v.position->y;
-			out[i + 2] = v.position->z;
-			// Out normal
-			out[i + 3] = v.normal->x;
-			out[i + 4] = v.normal->y;
-			out[i + 5] = v.normal->z;
+			Vertex* out = state.vertices.data() + span.target * 3;
+			for (size_t f = span.first; f < span.last; f++)
+			{
+				const FaceRecord& face = chunk.faces[f];
+				unsigned int face_index = static_cast<unsigned int>(span.target + (f - span.first));
+				for (int c = 0; c < 3; c++, out++)
+				{
+					out->position = face.pos_i[c] - 1;
+					out->normal = !has_normal ? 0 : !generated ? face.norm_i[c] - 1 : flat ? face_index : face.pos_i[c] - 1;
+					out->uv = has_uv ? face.uv_i[c] - 1 : 0;
+				}
+			}
 		}
+	}, threads);
+
+	merge_timer.stop();
+	track_staging(state);
+
+	// Generated normals and tangents live in the arena next to the attributes they are made from
+	if (has_normal && generated)
+	{
+		PhaseTimer normals_timer(state.stats, LoadPhase::Normals, state.origin);
+		if (flat)
+			generate_flat_normals(state.pos, state.vertices, state.generated, pool, threads);
+		else
+			generate_smooth_normals(state.pos, state.vertices, state.normal_mode == NormalMode::Angle, state.generated, pool, threads);
+	}
+	if (info.tangent_size > 0)
+	{
+		PhaseTimer tangents_timer(state.stats, LoadPhase::Tangents, state.origin);
+		generate_tangents(state.pos, state.uvs, state.vertices, state.tangents, pool, threads);
+	}
+	track_staging(state);
+}
+
+template <typename Layout>
+constexpr FormatInfo describe()
+{
+	return { Layout::stride, Layout::size_of(Attribute::Position), Layout::size_of(Attribute::Normal), Layout::size_of(Attribute::UV), Layout::size_of(Attribute::Tangent) };
+}
+
+FormatInfo format_info(VertexFormat format)
+{
+	switch (format)
+	{
+	case VertexFormat::PositionNormal:			return describe<LayoutPositionNormal>();
+	case VertexFormat::PositionUV:				return describe<LayoutPositionUV>();
+	case VertexFormat::Position:				return describe<LayoutPosition>();
+	case VertexFormat::PositionNormalPadded:	return describe<LayoutPositionNormalPadded>();
+	case VertexFormat::PositionNormalUVTangent:	return describe<LayoutPositionNormalUVTangent>();
+	default:									return describe<LayoutPositionNormalUV>();
 	}
+}
+
+unsigned int vertex_stride(VertexFormat format)
+{
+	return format == VertexFormat::Auto ? 0 : format_info(format).stride;
+}
+
+// Attribute byte sizes of the output, all 0 when the file has no valid faces
+void output_sizes(const State& state, unsigned int& position_size, unsigned int& normal_size, unsigned int& uv_size)
+{
+	FormatInfo info = state.position_size ? format_info(state.output_format()) : FormatInfo();
+	position_size = info.position_size;
+	normal_size = info.normal_size;
+	uv_size = info.uv_size;
+}
+
+// Floats per output vertex
+unsigned int out_stride(const State& state)
+{
+	return format_info(state.output_format()).stride / sizeof(float);
+}
+
+float* make_out_array(State& state, unsigned int count)
+{
+	PhaseTimer timer(state.stats, LoadPhase::Output, state.origin);
+	size_t floats = static_cast<size_t>(count) * out_stride(state);
+	float* out = allocate_output<float>(state, floats);
+	state.allocations++;
+	track_staging(state, floats * sizeof(float));
+	write_vertices(state, state.vertices.data(), count, output_sources(state, state.pos, state.normals, state.uvs), out);
 	return out;
 }
 
-bool CheckOutOfBounds(unsigned int count, std::initializer_list<unsigned int> indices);
+// Arrays the output reads from, a streamed load passes the attributes of its chunk
+VertexSources output_sources(const State& state, const StagingArray<Position>& pos, const StagingArray<Normal>& normals, const StagingArray<UV>& uvs)
+{
+	// Formats with UVs get zeros and any tangent when the file has none, every uv index is 0 then
+	static const UV no_uv = { 0.0f, 0.0f };
+	static const TangentSum no_tangent;
+
+	VertexSources sources;
+	sources.pos = pos.data();
+	sources.normals = state.generated_normals() ? state.generated.data() : normals.data();
+	sources.uvs = state.uv_size > 0 ? uvs.data() : &no_uv;
+	sources.tangents = state.tangents.empty() ? &no_tangent : state.tangents.data();
+	return sources;
+}
 
-void parse_face(std::string line)
+// One streaming pass over the staged triplets with the kernel of a layout, split in blocks across the pool
+template <typename Layout>
+void write_layout(const State& state, const Vertex* vertices, size_t count, const VertexSources& sources, float* out)
 {
-	unsigned int pos_i[3]{}, uv_i[3]{}, norm_i[3]{};
-	if (g_position_size > 0 && g_normal_size > 0 && g_uv_size > 0)
+	char* bytes = reinterpret_cast<char*>(out);
+	const size_t block = 1 << 16;
+	size_t blocks = (count + block - 1) / block;
+	state.pool->parallel_for(blocks, [&](size_t b)
 	{
-		if (9 != sscanf_s(line.c_str(), "f %u/%u/%u %u/%u/%u %u/%u/%u",
-						  &pos_i[0], &uv_i[0], &norm_i[0],
-						  &pos_i[1], &uv_i[1], &norm_i[1],
-						  &pos_i[2], &uv_i[2], &norm_i[2]))
-			return;
-		if (CheckOutOfBounds(pos.size(), { pos_i[0], pos_i[1], pos_i[2] }))
-			return;
-		if (CheckOutOfBounds(uvs.size(), { uv_i[0], uv_i[1], uv_i[2] }))
-			return;
-		if (CheckOutOfBounds(normals.size(), { norm_i[0], norm_i[1], norm_i[2] }))
-			return;
+		size_t first = b * block;
+		size_t last = first + block < count ? first + block : count;
+		gather_vertices<Layout>(vertices, first, last, sources, bytes + first * Layout::stride);
+	}, state.threads);
+}
+
+void write_vertices(const State& state, const Vertex* vertices, size_t count, const VertexSources& sources, float* out)
+{
+	switch (state.output_format())
+	{
+	case VertexFormat::PositionNormal:			write_layout<LayoutPositionNormal>(state, vertices, count, sources, out); break;
+	case VertexFormat::PositionUV:				write_layout<LayoutPositionUV>(state, vertices, count, sources, out); break;
+	case VertexFormat::Position:				write_layout<LayoutPosition>(state, vertices, count, sources, out); break;
+	case VertexFormat::PositionNormalPadded:	write_layout<LayoutPositionNormalPadded>(state, vertices, count, sources, out); break;
+	case VertexFormat::PositionNormalUVTangent:	write_layout<LayoutPositionNormalUVTangent>(state, vertices, count, sources, out); break;
+	default:									write_layout<LayoutPositionNormalUV>(state, vertices, count, sources, out); break;
+	}
+}
 
-		Vertex face[3]{};
-		face[0].position = &pos[pos_i[0] - 1];
-		face[1].position = &pos[pos_i[1] - 1];
-		face[2].position = &pos[pos_i[2] - 1];
+// Open addressing hash of the attribute indices of a vertex
+// Flat generated normals are unique per face, so their vertices are never merged
+size_t hash_vertex(const Vertex& v)
+{
+	uint64_t h = v.position * 0x9E3779B97F4A7C15ull;
+	h ^= (h >> 29) ^ v.uv * 0xC2B2AE3D27D4EB4Full;
+	h ^= (h >> 32) ^ v.normal * 0x165667B19E3779F9ull;
+	return static_cast<size_t>(h ^ (h >> 31));
+}
 
-		face[0].uv = &uvs[uv_i[0] - 1];
-		face[1].uv = &uvs[uv_i[1] - 1];
-		face[2].uv = &uvs[uv_i[2] - 1];
+unsigned int* make_index_array(State& state, unsigned int count)
+{
+	// Replaces the staged vertices by their unique ones and returns an index per staged vertex
+	PhaseTimer timer(state.stats, LoadPhase::Dedup, state.origin);
+	unsigned int* out = allocate_output<unsigned int>(state, count);
+	state.allocations++;
+	StagingArray<Vertex> unique(&state.arena);
+	unique.reserve(count / 2);
 
-		face[0].normal = &normals[norm_i[0] - 1];
-		face[1].normal = &normals[norm_i[1] - 1];
-		face[2].normal = &normals[norm_i[2] - 1];
+	// Power of two table at most half full, empty slots hold ~0
+	size_t capacity = 16;
+	while (capacity < static_cast<size_t>(count) * 2)
+		capacity <<= 1;
+	StagingArray<unsigned int> table(capacity, ~0u, &state.arena);
 
-		vertices.push(face[0]);
-		vertices.push(face[1]);
-		vertices.push(face[2]);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		const Vertex& v = state.vertices[i];
+		size_t slot = hash_vertex(v) & (capacity - 1);
+		while (table[slot] != ~0u)
+		{
+			const Vertex& other = unique[table[slot]];
+			if (other.position == v.position && other.uv == v.uv && other.normal == v.normal)
+				break;
+			slot = (slot + 1) & (capacity - 1);
+		}
+		if (table[slot] == ~0u)
+		{
+			table[slot] = static_cast<unsigned int>(unique.size());
+			unique.push_back(v);
+		}
+		out[i] = table[slot];
 	}
-	else if (g_position_size > 0 && g_uv_size > 0)
+
+	track_staging(state, static_cast<size_t>(count) * sizeof(unsigned int));
+	state.vertices.swap(unique);
+	return out;
+}
+
+void optimize_indexed(State& state, unsigned int* indices, unsigned int index_count, const LoadOptions& options, LoadStats* stats)
+{
+	// Reorders the triangles, then the unique vertices so the output is written in the order it is fetched
+	unsigned int vertex_count = static_cast<unsigned int>(state.vertices.size());
+	if (stats)
+		stats->cache_before = analyze_vertex_cache(indices, index_count, vertex_count, options.vertex_cache_size);
+	PhaseTimer timer(state.stats, LoadPhase::Optimize, state.origin);
+
+	// Triangles never leave their submesh range, each range is optimized on its own with dense vertex ids
+	std::vector<unsigned int> local(vertex_count, ~0u), globals;
+	std::vector<Position> positions;
+	for (const SubmeshRange& range : state.submesh_ranges)
 	{
-		if (6 != sscanf_s(line.c_str(), "f %u/%u %u/%u %u/%u",
-						  &pos_i[0], &uv_i[0],
-						  &pos_i[1], &uv_i[1],
-						  &pos_i[2], &uv_i[2]))
-			return;
-		if (CheckOutOfBounds(pos.size(), { pos_i[0], pos_i[1], pos_i[2] }))
-			return;
-		if (CheckOutOfBounds(uvs.size(), { uv_i[0], uv_i[1], uv_i[2] }))
-			return;
+		unsigned int* first = indices + range.first;
+		globals.clear();
+		for (unsigned int i = 0; i < range.count; i++)
+		{
+			unsigned int& id = local[first[i]];
+			if (id == ~0u)
+			{
+				id = static_cast<unsigned int>(globals.size());
+				globals.push_back(first[i]);
+			}
+			first[i] = id;
+		}
+		unsigned int range_vertices = static_cast<unsigned int>(globals.size());
 
-		Vertex face[3]{};
-		face[0].position = &pos[pos_i[0] - 1];
-		face[1].position = &pos[pos_i[1] - 1];
-		face[2].position = &pos[pos_i[2] - 1];
+		optimize_vertex_cache(first, range.count, range_vertices, options.vertex_cache_size);
+		if (options.optimize == MeshOptimization::Overdraw)
+		{
+			positions.resize(range_vertices);
+			for (unsigned int i = 0; i < range_vertices; i++)
+				positions[i] = state.pos[state.vertices[globals[i]].position];
+			optimize_overdraw(first, range.count, &positions.data()->x, 3, range_vertices, options.vertex_cache_size, options.overdraw_threshold);
+		}
 
-		face[0].uv = &uvs[uv_i[0] - 1];
-		face[1].uv = &uvs[uv_i[1] - 1];
-		face[2].uv = &uvs[uv_i[2] - 1];
+		for (unsigned int i = 0; i < range.count; i++)
+			first[i] = globals[first[i]];
+		for (unsigned int v : globals)
+			local[v] = ~0u;
+	}
 
-		Normal* n = generate_normals(face);
-		face[0].normal = n;
-		face[1].normal = n;
-		face[2].normal = n;
+	// Merged vertices are all referenced, so the remap is a permutation
+	std::vector<unsigned int> remap;
+	optimize_vertex_fetch(indices, index_count, vertex_count, remap);
+	StagingArray<Vertex> fetched(vertex_count, &state.arena);
+	for (unsigned int i = 0; i < vertex_count; i++)
+		fetched[remap[i]] = state.vertices[i];
+	state.vertices.swap(fetched);
 
-		vertices.push(face[0]);
-		vertices.push(face[1]);
-		vertices.push(face[2]);
+	timer.stop();
+	if (stats)
+	{
+		stats->cache_after = analyze_vertex_cache(indices, index_count, vertex_count, options.vertex_cache_size);
+		stats->optimize_ms = stats->wall_ms[static_cast<unsigned int>(LoadPhase::Optimize)];
 	}
-	else if (g_position_size > 0)
+}
+
+void collect_parts(const State& state, const char* path, MeshParts& parts)
+{
+	// Libraries are named relative to the file, a library named twice is read once
+	parts = MeshParts();
+	std::vector<Material> library;
+	std::filesystem::path directory = std::filesystem::path(path).parent_path();
+	for (size_t i = 0; i < state.libraries.size(); i++)
+		if (std::find(state.libraries.begin(), state.libraries.begin() + i, state.libraries[i]) == state.libraries.begin() + i)
+		{
+			parts.libraries.push_back((directory / state.libraries[i]).string());
+			parse_material_library(parts.libraries.back().c_str(), library);
+		}
+
+	// The first definition of a name wins
+	std::unordered_map<std::string, size_t> defined;
+	for (size_t m = 0; m < library.size(); m++)
+		defined.emplace(library[m].name, m);
+
+	parts.materials.resize(state.material_names.size());
+	std::vector<bool> used(library.size(), false);
+	for (size_t id = 0; id < state.material_names.size(); id++)
 	{
-		if (3 != sscanf_s(line.c_str(), "f %u %u %u", &pos_i[0], &pos_i[1], &pos_i[2]))
-			return;
-		if (CheckOutOfBounds(pos.size(), { pos_i[0], pos_i[1], pos_i[2] }))
-			return;
+		auto found = defined.find(state.material_names[id]);
+		if (found == defined.end())
+		{
+			parts.materials[id].name = state.material_names[id];
+			continue;
+		}
+		parts.materials[id] = library[found->second];
+		used[found->second] = true;
+	}
+	for (size_t m = 0; m < library.size(); m++)
+		if (!used[m] && defined[library[m].name] == m)
+			parts.materials.push_back(library[m]);
+	parts.material_ranges = state.material_ranges;
+	parts.submeshes = state.submesh_names;
+	parts.submesh_ranges = state.submesh_ranges;
+}
+
+void begin_stats(State& state, LoadStats* stats, std::chrono::steady_clock::time_point origin)
+{
+	state.stats = stats;
+	state.origin = origin;
+}
 
-		Vertex face[3]{};
-		face[0].position = &pos[pos_i[0] - 1];
-		face[1].position = &pos[pos_i[1] - 1];
-		face[2].position = &pos[pos_i[2] - 1];
+void track_staging(State& state, size_t extra)
+{
+	LoadStats* stats = state.stats;
+	if (!stats)
+		return;
 
-		Normal* n = generate_normals(face);
-		face[0].normal = n;
-		face[1].normal = n;
-		face[2].normal = n;
+	// The arena only grows during a load, what it handed out includes the old storage of arrays that grew
+	stats->peak_staging_bytes = std::max(stats->peak_staging_bytes, state.arena.used() + extra);
+	stats->allocations = state.allocations + state.arena.blocks_allocated();
+}
 
-		vertices.push(face[0]);
-		vertices.push(face[1]);
-		vertices.push(face[2]);
+void collect_stats(State& state, size_t parsed_faces)
+{
+	LoadStats* stats = state.stats;
+	if (!stats)
+		return;
+	for (const Chunk& chunk : state.chunks)
+	{
+		stats->lines += chunk.tally.lines;
+		stats->position_records += chunk.counts.pos;
+		stats->normal_records += chunk.counts.norm;
+		stats->uv_records += chunk.counts.uv;
+		stats->face_records += chunk.tally.faces;
+		stats->skipped_lines += chunk.tally.skipped;
+		stats->malformed_lines += chunk.tally.malformed;
+		stats->filtered_faces += chunk.tally.filtered;
 	}
+	// Every kept face is staged as three vertices, nothing is merged yet
+	stats->dropped_faces = parsed_faces - state.vertices.size() / 3;
+	track_staging(state);
 }
 
-bool CheckOutOfBounds(unsigned int count, std::initializer_list<unsigned int> indices)
+bool CheckOutOfBounds(unsigned int count, std::initializer_list<unsigned int> indices);
+
+// Reads one face corner written as "p", "p/t", "p//n" or "p/t/n", missing indices are left 0
+bool parse_face_index(Tokenizer& tokens, unsigned int& pos_i, unsigned int& uv_i, unsigned int& norm_i)
 {
-	bool b = false;
-	for (auto&& i : indices)
-		b |= i > count;
-	return b;
+	tokens.skip_space();
+	if (!tokens.parse_uint(pos_i))
+		return false;
+	if (tokens.consume('/'))
+	{
+		if (!tokens.consume('/'))
+		{
+			if (!tokens.parse_uint(uv_i))
+				return false;
+			if (!tokens.consume('/'))
+				return true;
+		}
+		if (!tokens.parse_uint(norm_i))
+			return false;
+	}
+	return true;
+}
+
+bool parse_face(Tokenizer& tokens, Chunk& chunk)
+{
+	// Only the first three corners are used, components the layout does not need are ignored
+	FaceRecord face{};
+	for (int i = 0; i < 3; i++)
+		if (!parse_face_index(tokens, face.pos_i[i], face.uv_i[i], face.norm_i[i]))
+			return false;
+
+	// Start a new run whenever attributes were added since the previous face
+	unsigned int pos_count = static_cast<unsigned int>(chunk.pos.size());
+	unsigned int norm_count = static_cast<unsigned int>(chunk.normals.size());
+	unsigned int uv_count = static_cast<unsigned int>(chunk.uvs.size());
+	if (chunk.runs.empty() || chunk.runs.back().pos != pos_count || chunk.runs.back().norm != norm_count || chunk.runs.back().uv != uv_count)
+		chunk.runs.push_back(FaceRun{ chunk.faces.size(), pos_count, norm_count, uv_count });
+	chunk.faces.push_back(face);
+	return true;
 }
 
-Normal* generate_normals(Vertex face[3])
+bool check_face(const State& state, const FaceRecord& face, const FaceRun& limits)
 {
-	glm::vec3 a = glm::vec3(face[0].position->x, face[0].position->y, face[0].position->z);
-	// b and c relative to a
-	glm::vec3 b = glm::vec3(face[1].position->x, face[1].position->y, face[1].position->z) - a;
-	glm::vec3 c = glm::vec3(face[2].position->x, face[2].position->y, face[2].position->z) - a;
+	if (CheckOutOfBounds(limits.pos, { face.pos_i[0], face.pos_i[1], face.pos_i[2] }))
+		return false;
+	if (state.uv_size > 0 && CheckOutOfBounds(limits.uv, { face.uv_i[0], face.uv_i[1], face.uv_i[2] }))
+		return false;
+	if (!state.generated_normals() && CheckOutOfBounds(limits.norm, { face.norm_i[0], face.norm_i[1], face.norm_i[2] }))
+		return false;
+	return true;
+}
 
-	glm::vec3 n = glm::normalize(glm::cross(b, c));
-	Normal* res = new Normal();
-	res->x = n.x;
-	res->y = n.y;
-	res->z = n.z;
-	return res;
+bool CheckOutOfBounds(unsigned int count, std::initializer_list<unsigned int> indices)
+{
+	// Indices are 1-based, a missing index is 0 and wraps around to out of bounds
+	bool b = false;
+	for (auto&& i : indices)
+		b |= i - 1 >= count;
+	return b;
 }
\ No newline at end of file
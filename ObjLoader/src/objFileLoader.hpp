@@ -1,7 +1,414 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "loadMemory.hpp"
+#include "materialLibrary.hpp"
+#include "meshletBuilder.hpp"
+#include "meshOptimizer.hpp"
+#include "vertexPacking.hpp"
+
+// How normals are generated for files without them
+enum class NormalMode
+{
+	Flat,	// One normal per face
+	Area,	// Smooth per position, faces weighted by their area
+	Angle	// Smooth per position, faces weighted by their angle at the position
+};
+
+// Vertex layout of the output arrays, every attribute is stored as floats in the order of the name
+enum class VertexFormat
+{
+	Auto,					// Position and normal, plus UV when the file has UVs
+	PositionNormalUV,		// UVs are 0 when the file has none
+	PositionNormal,
+	PositionUV,
+	Position,
+	PositionNormalPadded,	// Position and normal padded to 32 bytes
+	PositionNormalUVTangent	// Adds a unit tangent with the handedness of the bitangent in w
+};
+
+// Reordering of indexed output for the GPU, applied after equal vertices are merged
+enum class MeshOptimization
+{
+	None,
+	VertexCache,	// Triangles in post-transform cache order, then vertices in the order the triangles first use them
+	Overdraw		// Same, with clusters of the cache order drawn outside in to reduce overdraw at a small cache cost
+};
+
+// Bytes per output vertex, 0 for Auto as it depends on the file
+unsigned int vertex_stride(VertexFormat format);
+
+// Decides from the names of the current o and g lines whether the faces after them are loaded
+// Both are empty before the first line of their kind, and an o line also ends the group
+using SubmeshFilter = std::function<bool(std::string_view object, std::string_view group)>;
+
+// Filter keeping the faces of every object and group named in the list
+SubmeshFilter select_submeshes(std::vector<std::string> names);
+
+// Shared between a running load and other threads, which may watch it and ask it to stop
+struct LoadProgress
+{
+	// Input parsed so far out of the size of the file, updated about every 64 KB
+	std::atomic<size_t> bytes{ 0 };
+	std::atomic<size_t> total{ 0 };
+	// Checked as often as bytes is updated and between phases, a cancelled load frees its staging arrays and fails
+	std::atomic<bool> cancel{ false };
+};
+
+struct LoadOptions
+{
+	// Map the file into memory and parse it in place instead of streaming it line by line
+	bool memory_map = true;
+	// Read the file in large blocks, several reads in flight, while the threads parse the blocks already read
+	// Parsing no longer waits on page faults, which helps files that are not in the page cache yet
+	// Takes precedence over memory_map, streamed loads ignore it
+	bool pipeline = false;
+	// Threads parsing a mapped file in parallel, 0 uses every hardware thread and 1 parses serially
+	unsigned int threads = 0;
+	// Count the records of a mapped file first and reserve exact capacity before parsing
+	// Without it the capacity is estimated from samples of the file, which is a little over the count when its lines are alike
+	bool prepass = false;
+	// Keep the parsed chunks of a mapped load in the context, the next incremental load of a LoadContext parses only the chunks whose bytes changed
+	// Chunks end where the content says, so an edit only changes the chunks around it even when it moves the rest of the file
+	// Takes precedence over pipeline, compressed and filtered loads parse in full and one-shot loads have nothing to reuse
+	bool incremental = false;
+	NormalMode normals = NormalMode::Flat;
+	VertexFormat format = VertexFormat::Auto;
+	// Binary cache of the output, written after a parse and mapped instead of parsing while it still matches the file
+	// The source is hashed on every load, so an edited file rebuilds the cache even if its size and time are unchanged
+	const char* cache_path = nullptr;
+	// Only for indexed output, ignored otherwise
+	MeshOptimization optimize = MeshOptimization::None;
+	// Entries of the post-transform cache that is optimized for and simulated for the statistics
+	unsigned int vertex_cache_size = 16;
+	// Overdraw clusters may cost this many times the cache misses of the plain cache order
+	float overdraw_threshold = 1.05f;
+	// Sort the faces into one contiguous range per usemtl material, stable so each range keeps the file order
+	bool materials = true;
+	// Faces of the objects and groups it rejects are skipped before they are parsed, vertex lines are always kept as any face may use them
+	// Loads with a filter never use the cache
+	SubmeshFilter filter;
+	// Progress of the parse and cancellation, not used by streamed loads which their sink can already stop
+	LoadProgress* progress = nullptr;
+	// Where loadMesh allocates its output and the one-shot loads their staging arena, null for the default resource
+	// The loads returning raw arrays always allocate them with new[]
+	std::pmr::memory_resource* memory = nullptr;
+};
+
+// Material id of the faces before the first usemtl
+const unsigned int no_material = ~0u;
+
+// Faces of one material, first and count are vertices of loadObject or indices of loadIndexedObject
+struct MaterialRange
+{
+	unsigned int material = no_material;
+	unsigned int first = 0;
+	unsigned int count = 0;
+};
+
+// Object and group names in effect for some faces of the file
+struct Submesh
+{
+	std::string object;
+	std::string group;
+};
+
+// Faces of one submesh that share a material, first and count like MaterialRange
+struct SubmeshRange
+{
+	unsigned int submesh = 0;
+	unsigned int material = no_material;
+	unsigned int first = 0;
+	unsigned int count = 0;
+};
+
+// What a load knows about the parts of the mesh besides its vertices
+struct MeshParts
+{
+	// Indexed by material id, ids follow the first usemtl of every name in the file
+	// Names no library defines keep the default values, library materials never used come last
+	std::vector<Material> materials;
+	// One per material used in id order, then the faces without material, together they cover the output once
+	std::vector<MaterialRange> material_ranges;
+	// Indexed by submesh id, in the order their first loaded face appears in the file
+	// A pair of names that comes back later in the file keeps its id, pairs without loaded faces are left out
+	std::vector<Submesh> submeshes;
+	// In output order, a new range starts wherever the submesh or the material changes
+	// Each material range is split into the ranges of its submeshes, which keep their file order
+	std::vector<SubmeshRange> submesh_ranges;
+	// Paths of the material libraries the file names, joined to its directory, once each in file order
+	std::vector<std::string> libraries;
+};
+
+// Steps of a load in the order they run, tokenizing and number parsing are one phase as they interleave per line
+enum class LoadPhase
+{
+	Read,		// Opening and mapping the file
+	Decompress,	// Decompressing a compressed file, on a thread of its own while the chunks are parsed
+	Parse,		// Tokenizing every line and parsing its numbers, per chunk when parallel
+	Merge,		// Joining the chunks and building the staged faces
+	Normals,	// Generating normals for files without them
+	Tangents,
+	Dedup,		// Merging equal vertices of indexed output
+	Optimize,	// Reordering indexed output for the GPU
+	Output,		// Writing the output arrays
+	Cache		// Reading or writing the binary cache
+};
+
+const unsigned int load_phase_count = 10;
+
+const char* load_phase_name(LoadPhase phase);
+
+// One timed stretch of a load, milliseconds from the start of the load
+// Lane 0 is the calling thread, the chunks of a parallel parse get lane 1 and up
+struct LoadSpan
+{
+	LoadPhase phase = LoadPhase::Read;
+	unsigned int lane = 0;
+	double start_ms = 0.0;
+	double wall_ms = 0.0;
+	// CPU time of the whole process over the span, only measured on lane 0
+	double cpu_ms = 0.0;
+};
+
+// Filled by loads that are passed one, without it nothing is timed or counted beyond a few increments per line
+struct LoadStats
+{
+	// Wall and process CPU time per phase indexed by LoadPhase, phases that did not run stay 0
+	double wall_ms[load_phase_count] = {};
+	double cpu_ms[load_phase_count] = {};
+	double total_ms = 0.0;
+	std::vector<LoadSpan> spans;
+
+	// Input, the records count every line of their kind including malformed ones
+	// bytes is the decompressed size of a compressed file, compressed_bytes its size on disk and 0 for plain files
+	size_t bytes = 0;
+	size_t compressed_bytes = 0;
+	// Bytes of an incremental load whose chunks were taken over from the previous load instead of parsed
+	size_t reused_bytes = 0;
+	size_t lines = 0;
+	size_t position_records = 0;
+	size_t normal_records = 0;
+	size_t uv_records = 0;
+	size_t face_records = 0;
+	// Comments, blank lines and keywords the loader does not use
+	size_t skipped_lines = 0;
+	// Attribute and face lines whose numbers could not be read
+	size_t malformed_lines = 0;
+	// Triangles using an attribute that does not exist before them, and face lines of submeshes the filter rejected
+	size_t dropped_faces = 0;
+	size_t filtered_faces = 0;
+	// Blocks the staging arena took from its upstream resource plus the output arrays, temporaries of the optimizers are not counted
+	// A context that already holds enough memory from an earlier load only counts the output arrays
+	// The chunks of incremental loads live outside the arena, so they can be kept, and are not counted
+	size_t allocations = 0;
+	// Most bytes the staging arena handed out, plus the output arrays held at the same time
+	// Arrays that grew still count their old storage, which the arena only frees with the next load
+	size_t peak_staging_bytes = 0;
+
+	// Indexed output, referenced counts every face corner and unique the vertices left after merging equal ones
+	unsigned int referenced_vertices = 0;
+	unsigned int unique_vertices = 0;
+	double dedup_ratio = 0.0;
+	double dedup_ms = 0.0;
+	// Simulated cache efficiency of the index buffer before and after optimization, only filled when it runs
+	// A load from the cache reports the cached order for both
+	VertexCacheStats cache_before;
+	VertexCacheStats cache_after;
+	double optimize_ms = 0.0;
+};
+
+// Writes the spans and counts of a load as Chrome trace events, for chrome://tracing or Perfetto
+bool write_load_trace(const LoadStats& stats, const char* path);
+
+// Finished vertices handed out by a streamed load, laid out like the array of loadObject
+// The array is only valid during the call, count is always a multiple of 3
+struct VertexBatch
+{
+	const float* vertices = nullptr;
+	unsigned int count = 0;
+	// Vertices handed out by earlier batches of the same load
+	unsigned int first = 0;
+	unsigned int position_size = 0;
+	unsigned int normal_size = 0;
+	unsigned int uv_size = 0;
+};
+
+// Receives every batch of a streamed load, returning false stops the load
+using VertexSink = std::function<bool(const VertexBatch& batch)>;
+
+// Output of loadMesh, owning its arrays, which go back to the resource they came from
+struct Mesh
+{
+	// count vertices of stride bytes, laid out like the array of loadObject
+	OutputArray<float> vertices;
+	// Only for indexed loads
+	OutputArray<unsigned int> indices;
+	unsigned int count = 0;
+	unsigned int index_count = 0;
+	unsigned int stride = 0;
+	unsigned int position_size = 0;
+	unsigned int normal_size = 0;
+	unsigned int uv_size = 0;
+};
+
+// Owns all parse state of a load and keeps its memory for the next one
+// Staging arrays live in an arena that the next load rewinds in one step, so a load of a similar file allocates nothing new
+// A context runs one load at a time, separate contexts can load concurrently
+class LoadContext
+{
+public:
+	// The arena takes its blocks from upstream, the default resource when null
+	explicit LoadContext(std::pmr::memory_resource* upstream = nullptr);
+	~LoadContext();
+
+	LoadContext(const LoadContext&) = delete;
+	LoadContext& operator=(const LoadContext&) = delete;
+	LoadContext(LoadContext&&) noexcept;
+	LoadContext& operator=(LoadContext&&) noexcept;
+
+	// See loadObject
+	float* load(const char* path,
+				unsigned int& count,
+				unsigned int& position_size,
+				unsigned int& normal_size,
+				unsigned int& uv_size,
+				const LoadOptions& options = {},
+				MeshParts* parts = nullptr,
+				LoadStats* stats = nullptr);
+
+	// See loadIndexedObject
+	float* load_indexed(const char* path,
+						unsigned int& count,
+						unsigned int*& indices,
+						unsigned int& index_count,
+						unsigned int& position_size,
+						unsigned int& normal_size,
+						unsigned int& uv_size,
+						const LoadOptions& options = {},
+						LoadStats* stats = nullptr,
+						MeshParts* parts = nullptr);
+
+	// See loadMesh, mesh is emptied first
+	bool load_mesh(const char* path,
+				   Mesh& mesh,
+				   bool indexed = false,
+				   const LoadOptions& options = {},
+				   MeshParts* parts = nullptr,
+				   LoadStats* stats = nullptr);
+
+	// See loadPackedObject
+	unsigned char* load_packed(const char* path,
+							   unsigned int& count,
+							   unsigned int*& indices,
+							   unsigned int& index_count,
+							   Dequantization& dequantization,
+							   const PackOptions& pack = {},
+							   const LoadOptions& options = {});
+
+	// See loadMeshletObject
+	float* load_meshlets(const char* path,
+						 unsigned int& count,
+						 unsigned int& position_size,
+						 unsigned int& normal_size,
+						 unsigned int& uv_size,
+						 Meshlets& meshlets,
+						 const MeshletOptions& meshlet_options = {},
+						 const LoadOptions& options = {});
+
+	// See streamObject
+	bool stream(const char* path,
+				unsigned int batch_size,
+				const VertexSink& sink,
+				unsigned int& count,
+				const LoadOptions& options = {});
+
+	// Gives the memory kept for the next load back to the upstream resource
+	void release();
+
+	// Defined by the loader, opaque to callers
+	struct State;
+
+private:
+	std::unique_ptr<State> m_state;
+};
+
+// One-shot load through a temporary context, whose arena is freed in one step when it returns
+// Returns count vertices allocated with new[] and owned by the caller, null when the file could not be read or has no faces
+// parts receives the materials, read from the libraries next to the file, and the output ranges of every material, object and group
+// Loads asking for parts never use the cache, as the libraries are not part of its key
+// stats receives the time of every phase and the counts of the load, only the indexed fields stay 0
 float* loadObject(const char* path,
 				  unsigned int& count,
 				  unsigned int& position_size,
 				  unsigned int& normal_size,
-				  unsigned int& uv_size);
\ No newline at end of file
+				  unsigned int& uv_size,
+				  const LoadOptions& options = {},
+				  MeshParts* parts = nullptr,
+				  LoadStats* stats = nullptr);
+
+// Same as loadObject, but every unique (position, uv, normal) combination is stored once
+// Returns count unique vertices, indices receives index_count uint32 indices, 3 per triangle
+// Both arrays are allocated with new[] and owned by the caller
+// options.optimize reorders both for the GPU within each submesh range, stats then receives the simulated cache efficiency before and after
+float* loadIndexedObject(const char* path,
+						 unsigned int& count,
+						 unsigned int*& indices,
+						 unsigned int& index_count,
+						 unsigned int& position_size,
+						 unsigned int& normal_size,
+						 unsigned int& uv_size,
+						 const LoadOptions& options = {},
+						 LoadStats* stats = nullptr,
+						 MeshParts* parts = nullptr);
+
+// Same output as loadObject, or loadIndexedObject when indexed, in a mesh that owns its arrays
+// The arrays come from options.memory and go back to it when the mesh is destroyed
+// The mesh is empty when the file could not be read or has no faces
+Mesh loadMesh(const char* path,
+			  bool indexed = false,
+			  const LoadOptions& options = {},
+			  MeshParts* parts = nullptr,
+			  LoadStats* stats = nullptr);
+
+// Same vertices as loadObject, or loadIndexedObject when pack.indexed is set, quantized into a packed buffer
+// The attributes follow options.format, dequantization receives the layout and the parameters to decode it
+// indices is null and index_count 0 unless indexed, both arrays are allocated with new[] and owned by the caller
+// Packed loads never use the cache
+unsigned char* loadPackedObject(const char* path,
+								unsigned int& count,
+								unsigned int*& indices,
+								unsigned int& index_count,
+								Dequantization& dequantization,
+								const PackOptions& pack = {},
+								const LoadOptions& options = {});
+
+// Same vertices as loadIndexedObject, with the triangles split into meshlets instead of an index buffer
+// Vertices are ordered as the meshlets first use them, options.optimize does not apply and the cache is never used
+// Returns count vertices allocated with new[] and owned by the caller
+float* loadMeshletObject(const char* path,
+						 unsigned int& count,
+						 unsigned int& position_size,
+						 unsigned int& normal_size,
+						 unsigned int& uv_size,
+						 Meshlets& meshlets,
+						 const MeshletOptions& meshlet_options = {},
+						 const LoadOptions& options = {});
+
+// Parses the file in a single serial pass and hands its vertices to sink in batches of up to batch_size as soon as they are complete
+// Memory stays at the attribute arrays and one batch, however many faces the file has
+// Generated normals are always flat and formats with tangents are rejected, both need every face of the mesh first
+// Faces are handed out in file order, materials are not sorted
+// count receives the number of vertices handed out, returns false if the file could not be read
+bool streamObject(const char* path,
+				  unsigned int batch_size,
+				  const VertexSink& sink,
+				  unsigned int& count,
+				  const LoadOptions& options = {});
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <memory_resource>
+#include <vector>
+
+// Attribute types shared by the loader and its mesh stages
+
+struct Position { float x, y, z; };
+
+struct Normal { float x, y, z; };
+
+struct UV { float x, y; };
+
+// One output vertex as 0-based indices into the attribute arrays
+// Generated normals are indexed by face when flat and by position when smooth
+struct Vertex { unsigned int position, normal, uv; };
+
+// Unit tangent and the handedness of the bitangent, bitangent = w * cross(normal, tangent)
+struct Tangent { float x, y, z, w; };
+
+// Summed tangent and bitangent directions of the faces around a UV, made orthogonal per vertex on output
+struct TangentSum { float tx = 0.0f, ty = 0.0f, tz = 0.0f, bx = 0.0f, by = 0.0f, bz = 0.0f; };
+
+// Array of a load while it builds the mesh, allocated from the arena of its context
+template <typename T>
+using StagingArray = std::pmr::vector<T>;
@@ -0,0 +1,201 @@
+#pragma once
+
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+// Locale independent tokenizer over a single line of an OBJ file
+// Numbers are parsed in place, the line does not need to be terminated
+struct Tokenizer
+{
+	const char* it;
+	const char* end;
+
+	explicit Tokenizer(std::string_view line) : it(line.data()), end(line.data() + line.size()) {}
+
+	static bool is_space(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+	static bool is_digit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+	void skip_space()
+	{
+		while (it != end && is_space(*it))
+			it++;
+	}
+
+	// Next whitespace delimited token, empty at the end of the line
+	std::string_view next_token()
+	{
+		skip_space();
+		const char* start = it;
+		while (it != end && !is_space(*it))
+			it++;
+		return std::string_view(start, it - start);
+	}
+
+	// Remainder of the line without surrounding whitespace, for names that may contain spaces
+	std::string_view rest()
+	{
+		skip_space();
+		const char* last = end;
+		while (last != it && is_space(last[-1]))
+			last--;
+		std::string_view out(it, last - it);
+		it = end;
+		return out;
+	}
+
+	bool consume(char c)
+	{
+		if (it != end && *it == c)
+		{
+			it++;
+			return true;
+		}
+		return false;
+	}
+
+	// Unsigned decimal integer, no sign and no leading whitespace
+	bool parse_uint(unsigned int& out)
+	{
+		const char* start = it;
+		uint64_t value = 0;
+		// Single unsigned compare per digit, overflow is checked once at the end
+		while (it != end && is_digit(*it) && it - start < 10)
+			value = value * 10 + static_cast<unsigned char>(*it++ - '0');
+		if (it == start || value > 0xFFFFFFFFu || (it != end && is_digit(*it)))
+			return false;
+		out = static_cast<unsigned int>(value);
+		return true;
+	}
+
+	// Float with the same result as strtof, skips leading whitespace
+	bool parse_float(float& out);
+
+private:
+	// SWAR checks for eight ASCII digits packed little endian in one word
+	static bool is_eight_digits(uint64_t v)
+	{
+		return (((v + 0x4646464646464646ull) | (v - 0x3030303030303030ull)) & 0x8080808080808080ull) == 0;
+	}
+
+	static uint32_t parse_eight_digits(uint64_t v)
+	{
+		const uint64_t mask = 0x000000FF000000FFull;
+		const uint64_t mul1 = 0x000F424000000064ull; // 100 + (1000000 << 32)
+		const uint64_t mul2 = 0x0000271000000001ull; // 1 + (10000 << 32)
+		v -= 0x3030303030303030ull;
+		v = (v * 10) + (v >> 8);
+		v = (((v & mask) * mul1) + (((v >> 16) & mask) * mul2)) >> 32;
+		return static_cast<uint32_t>(v);
+	}
+};
+
+inline bool Tokenizer::parse_float(float& out)
+{
+	// Powers of ten that are exact in single precision
+	static const float exact_powers[] = { 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f, 1e10f };
+
+	skip_space();
+	const char* start = it;
+	bool negative = it != end && *it == '-';
+	if (it != end && (*it == '-' || *it == '+'))
+		it++;
+	const char* number = it;
+
+	// Accumulate every digit, the mantissa is only trusted below 20 significant digits
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	const char* first_digit = it;
+	while (it != end && is_digit(*it))
+		mantissa = mantissa * 10 + static_cast<unsigned char>(*it++ - '0');
+	int digits = static_cast<int>(it - first_digit);
+	if (it != end && *it == '.')
+	{
+		const char* fraction = ++it;
+		// Eight digits at a time while there are enough bytes left
+		while (end - it >= 8)
+		{
+			uint64_t word;
+			memcpy(&word, it, sizeof(word));
+			if (!is_eight_digits(word))
+				break;
+			mantissa = mantissa * 100000000ull + parse_eight_digits(word);
+			it += 8;
+		}
+		while (it != end && is_digit(*it))
+			mantissa = mantissa * 10 + static_cast<unsigned char>(*it++ - '0');
+		exponent = -static_cast<int>(it - fraction);
+		digits += static_cast<int>(it - fraction);
+	}
+	if (digits == 0)
+	{
+		// No digits, might still be inf or nan
+		it = start;
+		const char* first = it != end && *it == '+' ? it + 1 : it;
+		auto result = std::from_chars(first, end, out);
+		if (result.ec != std::errc())
+			return false;
+		it = result.ptr;
+		return true;
+	}
+
+	int explicit_exponent = 0;
+	if (it != end && (*it == 'e' || *it == 'E'))
+	{
+		const char* mark = it++;
+		bool negative_exponent = it != end && *it == '-';
+		if (it != end && (*it == '-' || *it == '+'))
+			it++;
+		if (it != end && is_digit(*it))
+		{
+			int value = 0;
+			for (; it != end && is_digit(*it); it++)
+				if (value < 100000)
+					value = value * 10 + (*it - '0');
+			explicit_exponent = negative_exponent ? -value : value;
+			exponent += explicit_exponent;
+		}
+		else
+			it = mark; // Not an exponent, the number ends before the 'e'
+	}
+
+	// Leading zeros do not count against the digits a 64-bit mantissa can hold
+	int significant = digits;
+	for (const char* p = first_digit; significant > 19 && p != it && (*p == '0' || *p == '.'); p++)
+		significant -= *p == '0';
+
+	// Clinger's fast path, both operands are exact so the single rounding matches strtof
+	if (significant <= 19 && mantissa <= (1u << 24) && exponent >= -10 && exponent <= 10)
+	{
+		float value = static_cast<float>(mantissa);
+		value = exponent < 0 ? value / exact_powers[-exponent] : value * exact_powers[exponent];
+		out = negative ? -value : value;
+		return true;
+	}
+
+	// Everything else goes through the correctly rounded library conversion
+	float value;
+	auto result = std::from_chars(number, it, value);
+	if (result.ec == std::errc::invalid_argument)
+		return false;
+	if (result.ec == std::errc::result_out_of_range)
+	{
+		// strtof saturates to infinity or flushes to zero, which one follows from the decimal magnitude
+		// The value lies below 10^magnitude and at or above a tenth of it
+		int magnitude = explicit_exponent;
+		const char* p = number;
+		while (p != it && *p == '0')
+			p++;
+		if (p != it && is_digit(*p))
+			for (; p != it && is_digit(*p); p++)
+				magnitude++;
+		else if (p != it && *p == '.')
+			for (p++; p != it && *p == '0'; p++)
+				magnitude--;
+		value = magnitude > 0 ? HUGE_VALF : 0.0f;
+	}
+	out = negative ? -value : value;
+	return true;
+}
@@ -0,0 +1,126 @@
+#include "tangentGenerator.hpp"
+
+#include <algorithm>
+
+#include <glm/vec2.hpp>
+#include <glm/vec3.hpp>
+#include <glm/geometric.hpp>
+
+#include "threadPool.hpp"
+
+// Faces or UVs handled per parallel task
+const size_t tangent_block_size = 1 << 14;
+
+void generate_tangents(const StagingArray<Position>& pos, StagingArray<UV>& uvs, StagingArray<Vertex>& vertices, StagingArray<TangentSum>& tangents, ThreadPool& pool, unsigned int threads)
+{
+	tangents.clear();
+	if (uvs.empty())
+		return;
+
+	size_t faces = vertices.size() / 3;
+	size_t corners = faces * 3;
+
+	// Tangent and bitangent of every face, unit length and weighted by the face area
+	std::vector<TangentSum> face_tangents(faces);
+	size_t face_blocks = (faces + tangent_block_size - 1) / tangent_block_size;
+	pool.parallel_for(face_blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * tangent_block_size < faces ? (b + 1) * tangent_block_size : faces;
+		for (size_t f = b * tangent_block_size; f < last; f++)
+		{
+			const Vertex* face = vertices.data() + f * 3;
+			glm::vec3 p0(pos[face[0].position].x, pos[face[0].position].y, pos[face[0].position].z);
+			glm::vec3 e1 = glm::vec3(pos[face[1].position].x, pos[face[1].position].y, pos[face[1].position].z) - p0;
+			glm::vec3 e2 = glm::vec3(pos[face[2].position].x, pos[face[2].position].y, pos[face[2].position].z) - p0;
+			glm::vec2 t0(uvs[face[0].uv].x, uvs[face[0].uv].y);
+			glm::vec2 d1 = glm::vec2(uvs[face[1].uv].x, uvs[face[1].uv].y) - t0;
+			glm::vec2 d2 = glm::vec2(uvs[face[2].uv].x, uvs[face[2].uv].y) - t0;
+
+			// Faces with a degenerate mapping do not contribute
+			TangentSum& out = face_tangents[f];
+			float r = d1.x * d2.y - d2.x * d1.y;
+			glm::vec3 t = (e1 * d2.y - e2 * d1.y) * (r < 0.0f ? -1.0f : 1.0f);
+			glm::vec3 s = (e2 * d1.x - e1 * d2.x) * (r < 0.0f ? -1.0f : 1.0f);
+			float t_length = glm::length(t), s_length = glm::length(s);
+			if (r == 0.0f || !(t_length > 0.0f) || !(s_length > 0.0f))
+			{
+				out = TangentSum();
+				continue;
+			}
+			float area = glm::length(glm::cross(e1, e2));
+			t *= area / t_length;
+			s *= area / s_length;
+			out = { t.x, t.y, t.z, s.x, s.y, s.z };
+		}
+	}, threads);
+
+	// Corners grouped by UV, filled in face order so every sum has a fixed order
+	size_t uv_count = uvs.size();
+	std::vector<unsigned int> offsets(uv_count + 1, 0);
+	for (size_t i = 0; i < corners; i++)
+		offsets[vertices[i].uv + 1]++;
+	for (size_t u = 0; u < uv_count; u++)
+		offsets[u + 1] += offsets[u];
+	std::vector<unsigned int> cursor(offsets.begin(), offsets.end() - 1);
+	std::vector<unsigned int> adjacency(corners);
+	for (size_t i = 0; i < corners; i++)
+		adjacency[cursor[vertices[i].uv]++] = static_cast<unsigned int>(i);
+	cursor = std::vector<unsigned int>();
+
+	// Corners sharing a UV but not the position and normal, like mirrored halves, get a copy of the UV each
+	// Otherwise their tangents would be summed together and the opposite handedness cancel out
+	std::vector<unsigned int> copies(uv_count + 1, 0);
+	size_t uv_blocks = (uv_count + tangent_block_size - 1) / tangent_block_size;
+	pool.parallel_for(uv_blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * tangent_block_size < uv_count ? (b + 1) * tangent_block_size : uv_count;
+		for (size_t u = b * tangent_block_size; u < last; u++)
+		{
+			// Sorted by position and normal, corners of the same vertex keep face order
+			auto first = adjacency.begin() + offsets[u], end = adjacency.begin() + offsets[u + 1];
+			std::sort(first, end, [&](unsigned int a, unsigned int c)
+			{
+				const Vertex& va = vertices[a];
+				const Vertex& vc = vertices[c];
+				return va.position != vc.position ? va.position < vc.position : va.normal != vc.normal ? va.normal < vc.normal : a < c;
+			});
+			for (auto it = first; it != end && it + 1 != end; ++it)
+				copies[u + 1] += vertices[*it].position != vertices[*(it + 1)].position || vertices[*it].normal != vertices[*(it + 1)].normal;
+		}
+	}, threads);
+	for (size_t u = 0; u < uv_count; u++)
+		copies[u + 1] += copies[u];
+	uvs.resize(uv_count + copies[uv_count]);
+	tangents.assign(uvs.size(), TangentSum());
+
+	pool.parallel_for(uv_blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * tangent_block_size < uv_count ? (b + 1) * tangent_block_size : uv_count;
+		for (size_t u = b * tangent_block_size; u < last; u++)
+		{
+			// The first vertex keeps the UV, the others take the copies in order
+			unsigned int index = static_cast<unsigned int>(u);
+			unsigned int next_copy = static_cast<unsigned int>(uv_count) + copies[u];
+			TangentSum sum;
+			for (unsigned int i = offsets[u]; i < offsets[u + 1]; i++)
+			{
+				Vertex& vertex = vertices[adjacency[i]];
+				const TangentSum& face = face_tangents[adjacency[i] / 3];
+				sum.tx += face.tx, sum.ty += face.ty, sum.tz += face.tz;
+				sum.bx += face.bx, sum.by += face.by, sum.bz += face.bz;
+				vertex.uv = index;
+
+				bool vertex_ends = i + 1 == offsets[u + 1] || vertex.position != vertices[adjacency[i + 1]].position || vertex.normal != vertices[adjacency[i + 1]].normal;
+				if (!vertex_ends)
+					continue;
+				tangents[index] = sum;
+				sum = TangentSum();
+				if (i + 1 < offsets[u + 1])
+				{
+					index = next_copy++;
+					uvs[index] = uvs[u];
+				}
+			}
+		}
+	}, threads);
+}
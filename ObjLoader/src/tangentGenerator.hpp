@@ -0,0 +1,52 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+
+#include "objMesh.hpp"
+
+class ThreadPool;
+
+// One tangent sum per UV, the area weighted directions of every face using it
+// The sum per UV always runs in face order, so the result does not depend on the thread count
+// Keyed by UV, so seams in the mapping keep their own tangents
+// Vertices that share a UV with a different position or normal are moved to a copy of it first,
+// so every sum belongs to a single vertex and mirrored or reused parts of the mapping stay apart
+void generate_tangents(const StagingArray<Position>& pos,
+					   StagingArray<UV>& uvs,
+					   StagingArray<Vertex>& vertices,
+					   StagingArray<TangentSum>& tangents,
+					   ThreadPool& pool,
+					   unsigned int threads);
+
+// Tangent of a vertex, the sum made orthogonal to its normal, w is the handedness of the bitangent
+// Vertices without a usable UV direction get any tangent orthogonal to the normal
+inline Tangent resolve_tangent(const TangentSum& sum, const Normal& normal)
+{
+	// File normals are not necessarily unit length
+	float n_length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+	float n_scale = n_length > 0.0f ? 1.0f / n_length : 0.0f;
+	Normal n = { normal.x * n_scale, normal.y * n_scale, normal.z * n_scale };
+
+	// Gram-Schmidt against the normal
+	float d = n.x * sum.tx + n.y * sum.ty + n.z * sum.tz;
+	float x = sum.tx - n.x * d, y = sum.ty - n.y * d, z = sum.tz - n.z * d;
+	float length = std::sqrt(x * x + y * y + z * z);
+	if (!(length > 1e-20f))
+	{
+		// Cross product with the axis least aligned to the normal
+		bool use_y = std::fabs(n.x) > 0.9f;
+		x = use_y ? -n.z : 0.0f;
+		y = use_y ? 0.0f : n.z;
+		z = use_y ? n.x : -n.y;
+		length = std::sqrt(x * x + y * y + z * z);
+		if (!(length > 0.0f))
+			return { 1.0f, 0.0f, 0.0f, 1.0f };
+	}
+	x /= length, y /= length, z /= length;
+
+	// Bitangent on the side of n x t or the mirrored one
+	float cx = n.y * z - n.z * y, cy = n.z * x - n.x * z, cz = n.x * y - n.y * x;
+	float w = cx * sum.bx + cy * sum.by + cz * sum.bz < 0.0f ? -1.0f : 1.0f;
+	return { x, y, z, w };
+}
@@ -0,0 +1,120 @@
+#include "threadPool.hpp"
+
+#include <atomic>
+#include <exception>
+#include <memory>
+
+ThreadPool::ThreadPool(unsigned int threads)
+{
+	if (threads == 0)
+		threads = std::thread::hardware_concurrency();
+	if (threads == 0)
+		threads = 1;
+	m_workers.reserve(threads);
+	for (unsigned int i = 0; i < threads; i++)
+		m_workers.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stop = true;
+	}
+	m_wake.notify_all();
+	for (auto& worker : m_workers)
+		worker.join();
+}
+
+std::future<void> ThreadPool::submit(std::function<void()> task)
+{
+	std::packaged_task<void()> packaged(std::move(task));
+	std::future<void> result = packaged.get_future();
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_tasks.push(std::move(packaged));
+	}
+	m_wake.notify_one();
+	return result;
+}
+
+void ThreadPool::parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned int max_threads)
+{
+	if (count == 0)
+		return;
+	if (count == 1 || max_threads == 1)
+	{
+		for (size_t i = 0; i < count; i++)
+			fn(i);
+		return;
+	}
+
+	// Helpers may start after the loop is already finished, so the shared state outlives this call
+	struct State
+	{
+		std::atomic<size_t> next{ 0 };
+		size_t done = 0;
+		std::exception_ptr error;
+		std::mutex mutex;
+		std::condition_variable finished;
+	};
+	auto state = std::make_shared<State>();
+	const std::function<void(size_t)>* body = &fn;
+
+	auto run = [state, body, count]()
+	{
+		for (size_t i = state->next++; i < count; i = state->next++)
+		{
+			std::exception_ptr error;
+			try
+			{
+				(*body)(i);
+			}
+			catch (...)
+			{
+				error = std::current_exception();
+			}
+			std::lock_guard<std::mutex> lock(state->mutex);
+			if (error && !state->error)
+				state->error = error;
+			if (++state->done == count)
+				state->finished.notify_all();
+		}
+	};
+
+	size_t helpers = count - 1 < m_workers.size() ? count - 1 : m_workers.size();
+	if (max_threads && helpers > max_threads - 1)
+		helpers = max_threads - 1;
+	for (size_t i = 0; i < helpers; i++)
+		submit(run);
+	run();
+
+	// Only claimed indices are waited on, never helpers that have not started
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&] { return state->done == count; });
+	if (state->error)
+		std::rethrow_exception(state->error);
+}
+
+ThreadPool& ThreadPool::shared()
+{
+	static ThreadPool pool;
+	return pool;
+}
+
+void ThreadPool::work()
+{
+	for (;;)
+	{
+		std::packaged_task<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [this] { return m_stop || !m_tasks.empty(); });
+			if (m_stop && m_tasks.empty())
+				return;
+			task = std::move(m_tasks.front());
+			m_tasks.pop();
+		}
+		task();
+	}
+}
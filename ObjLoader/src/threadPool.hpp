@@ -0,0 +1,43 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads consuming a shared task queue
+class ThreadPool
+{
+public:
+	// 0 threads uses one per hardware thread
+	explicit ThreadPool(unsigned int threads = 0);
+	~ThreadPool();
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	unsigned int size() const { return static_cast<unsigned int>(m_workers.size()); }
+
+	std::future<void> submit(std::function<void()> task);
+
+	// Runs fn(i) for every i in [0, count) and returns when all calls have finished
+	// The calling thread takes part, so this is safe to call from inside a pool task
+	// At most max_threads threads including the caller work on the loop, 0 means no limit
+	void parallel_for(size_t count, const std::function<void(size_t)>& fn, unsigned int max_threads = 0);
+
+	// Pool shared by every load that does not bring its own
+	static ThreadPool& shared();
+
+private:
+	void work();
+
+	std::vector<std::thread> m_workers;
+	std::queue<std::packaged_task<void()>> m_tasks;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	bool m_stop = false;
+};
@@ -0,0 +1,131 @@
+#pragma once
+
+#include <cstddef>
+#include <cstring>
+#include <utility>
+
+#include "objMesh.hpp"
+#include "tangentGenerator.hpp"
+
+// Attributes a vertex layout can hold
+enum class Attribute { Position, Normal, UV, Tangent };
+
+// One attribute of a layout, its components are stored as T
+template <Attribute A, typename T = float>
+struct AttributeSlot
+{
+	static constexpr Attribute attribute = A;
+	using Component = T;
+	static constexpr unsigned int components = A == Attribute::UV ? 2 : A == Attribute::Tangent ? 4 : 3;
+	static constexpr unsigned int size = components * sizeof(T);
+};
+
+// Attribute arrays a layout reads from, arrays it does not use may be null
+// Tangent sums are indexed by UV and made orthogonal to the normal of each vertex
+struct VertexSources
+{
+	const Position* pos = nullptr;
+	const Normal* normals = nullptr;
+	const UV* uvs = nullptr;
+	const TangentSum* tangents = nullptr;
+};
+
+// Attributes in output order, the stride is padded to a multiple of Alignment bytes
+// Everything is known at compile time, so the writer of every layout is its own fully unrolled kernel
+template <unsigned int Alignment, typename... Slots>
+struct VertexLayout
+{
+	static_assert(sizeof...(Slots) > 0, "a layout needs at least one attribute");
+	static_assert(Alignment > 0 && (Alignment & (Alignment - 1)) == 0, "alignment must be a power of two");
+
+	static constexpr unsigned int size = (Slots::size + ...);
+	static constexpr unsigned int stride = (size + Alignment - 1) & ~(Alignment - 1);
+
+	// Byte size of an attribute in the layout, 0 when absent
+	static constexpr unsigned int size_of(Attribute a) { return ((Slots::attribute == a ? Slots::size : 0) + ...); }
+
+	// Byte offset of the slot at index i
+	static constexpr unsigned int offset(size_t i)
+	{
+		constexpr unsigned int sizes[] = { Slots::size... };
+		unsigned int bytes = 0;
+		for (size_t s = 0; s < i; s++)
+			bytes += sizes[s];
+		return bytes;
+	}
+
+	// Writes one vertex, attribute arrays the layout does not use are never read
+	static void write(char* out, const Vertex& v, const VertexSources& sources)
+	{
+		write_slots(out, v, sources, std::index_sequence_for<Slots...>());
+		if constexpr (stride > size)
+			memset(out + size, 0, stride - size);
+	}
+
+private:
+	template <size_t... I>
+	static void write_slots(char* out, const Vertex& v, const VertexSources& sources, std::index_sequence<I...>)
+	{
+		(write_slot<Slots>(out + offset(I), v, sources), ...);
+	}
+
+	template <typename Slot>
+	static void write_slot(char* out, const Vertex& v, const VertexSources& sources)
+	{
+		using T = typename Slot::Component;
+		T c[Slot::components];
+		if constexpr (Slot::attribute == Attribute::Position)
+		{
+			const Position& p = sources.pos[v.position];
+			c[0] = static_cast<T>(p.x);
+			c[1] = static_cast<T>(p.y);
+			c[2] = static_cast<T>(p.z);
+		}
+		else if constexpr (Slot::attribute == Attribute::Normal)
+		{
+			const Normal& n = sources.normals[v.normal];
+			c[0] = static_cast<T>(n.x);
+			c[1] = static_cast<T>(n.y);
+			c[2] = static_cast<T>(n.z);
+		}
+		else if constexpr (Slot::attribute == Attribute::UV)
+		{
+			const UV& t = sources.uvs[v.uv];
+			c[0] = static_cast<T>(t.x);
+			c[1] = static_cast<T>(t.y);
+		}
+		else
+		{
+			Tangent t = resolve_tangent(sources.tangents[v.uv], sources.normals[v.normal]);
+			c[0] = static_cast<T>(t.x);
+			c[1] = static_cast<T>(t.y);
+			c[2] = static_cast<T>(t.z);
+			c[3] = static_cast<T>(t.w);
+		}
+		memcpy(out, c, sizeof(c));
+	}
+};
+
+// Writes vertices [first, last) one after another from out on
+template <typename Layout>
+void gather_vertices(const Vertex* vertices, size_t first, size_t last, const VertexSources& sources, char* out)
+{
+	for (size_t i = first; i < last; i++, out += Layout::stride)
+		Layout::write(out, vertices[i], sources);
+}
+
+// Layouts of the renderers, selected at run time through VertexFormat
+using PositionSlot = AttributeSlot<Attribute::Position>;
+using NormalSlot = AttributeSlot<Attribute::Normal>;
+using UVSlot = AttributeSlot<Attribute::UV>;
+using TangentSlot = AttributeSlot<Attribute::Tangent>;
+
+using LayoutPositionNormalUV = VertexLayout<4, PositionSlot, NormalSlot, UVSlot>;
+using LayoutPositionNormal = VertexLayout<4, PositionSlot, NormalSlot>;
+using LayoutPositionUV = VertexLayout<4, PositionSlot, UVSlot>;
+using LayoutPosition = VertexLayout<4, PositionSlot>;
+using LayoutPositionNormalPadded = VertexLayout<32, PositionSlot, NormalSlot>;
+using LayoutPositionNormalUVTangent = VertexLayout<4, PositionSlot, NormalSlot, UVSlot, TangentSlot>;
+
+static_assert(LayoutPositionNormalUV::stride == 32 && LayoutPositionNormalUV::offset(2) == 24, "unexpected layout");
+static_assert(LayoutPositionNormalPadded::stride == 32 && LayoutPositionNormalPadded::size == 24, "unexpected layout");
@@ -0,0 +1,254 @@
+#include "vertexPacking.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#include <glm/vec2.hpp>
+#include <glm/vec4.hpp>
+#include <glm/geometric.hpp>
+#include <glm/packing.hpp>
+#include <glm/gtc/packing.hpp>
+
+#include "threadPool.hpp"
+
+// Vertices handled per parallel task and per vectorized batch
+const size_t pack_block_size = 1 << 16;
+const size_t pack_batch_size = 64;
+
+// Attributes of a batch of vertices in structure of arrays layout, quantized in place
+// Only the gather and the interleaving are scalar, the arithmetic loops are left to the compiler to vectorize
+// They always run over the whole batch, a fixed trip count vectorizes even at the cheapest cost model
+// Rounding matches glm::packUnorm and glm::packSnorm, so the glm unpack functions decode the result exactly
+struct PackBatch
+{
+	uint16_t px[pack_batch_size], py[pack_batch_size], pz[pack_batch_size];
+	int16_t ox[pack_batch_size], oy[pack_batch_size];
+	float u[pack_batch_size], v[pack_batch_size];
+
+	// Positions to unorm16 inside the bounds
+	void load_positions(const Position* pos, const Vertex* vertices, size_t first, size_t count, const float min[3], const float scale[3])
+	{
+		float x[pack_batch_size], y[pack_batch_size], z[pack_batch_size];
+		for (size_t i = 0; i < count; i++)
+		{
+			const Position& p = pos[vertices[first + i].position];
+			x[i] = p.x;
+			y[i] = p.y;
+			z[i] = p.z;
+		}
+		for (size_t i = count; i < pack_batch_size; i++)
+			x[i] = y[i] = z[i] = 0.0f;
+		for (size_t i = 0; i < pack_batch_size; i++)
+		{
+			px[i] = unorm16((x[i] - min[0]) * scale[0]);
+			py[i] = unorm16((y[i] - min[1]) * scale[1]);
+			pz[i] = unorm16((z[i] - min[2]) * scale[2]);
+		}
+	}
+
+	// Normals projected on the octahedron, unfolded to [-1, 1]^2 and stored as snorm with the given maximum
+	void load_normals(const Normal* normals, const Vertex* vertices, size_t first, size_t count, float maximum)
+	{
+		float x[pack_batch_size], y[pack_batch_size], z[pack_batch_size];
+		for (size_t i = 0; i < count; i++)
+		{
+			const Normal& n = normals[vertices[first + i].normal];
+			x[i] = n.x;
+			y[i] = n.y;
+			z[i] = n.z;
+		}
+		for (size_t i = count; i < pack_batch_size; i++)
+			x[i] = y[i] = z[i] = 0.0f;
+		for (size_t i = 0; i < pack_batch_size; i++)
+		{
+			float length = std::fabs(x[i]) + std::fabs(y[i]) + std::fabs(z[i]);
+			float inverse = (length > 0.0f ? 1.0f : 0.0f) / (length > 0.0f ? length : 1.0f);
+			float a = x[i] * inverse;
+			float b = y[i] * inverse;
+			// The lower half folds over the diagonals
+			float fa = (1.0f - std::fabs(b)) * (a >= 0.0f ? 1.0f : -1.0f);
+			float fb = (1.0f - std::fabs(a)) * (b >= 0.0f ? 1.0f : -1.0f);
+			ox[i] = snorm(z[i] < 0.0f ? fa : a, maximum);
+			oy[i] = snorm(z[i] < 0.0f ? fb : b, maximum);
+		}
+	}
+
+	void load_uvs(const UV* uvs, const Vertex* vertices, size_t first, size_t count)
+	{
+		for (size_t i = 0; i < count; i++)
+		{
+			const UV& t = uvs[vertices[first + i].uv];
+			u[i] = t.x;
+			v[i] = t.y;
+		}
+	}
+
+	// Round half away from zero like glm, adding 0.5 is exact in this range
+	// NaN fails both compares of the clamp, it is packed as 0 instead of reaching the integer conversion
+	static uint16_t unorm16(float value)
+	{
+		if (!(value == value))
+			value = 0.0f;
+		value = value < 0.0f ? 0.0f : value > 1.0f ? 1.0f : value;
+		return static_cast<uint16_t>(static_cast<int32_t>(value * 65535.0f + 0.5f));
+	}
+
+	static int16_t snorm(float value, float maximum)
+	{
+		if (!(value == value))
+			value = 0.0f;
+		value = value < -1.0f ? -1.0f : value > 1.0f ? 1.0f : value;
+		value *= maximum;
+		return static_cast<int16_t>(static_cast<int32_t>(value + (value >= 0.0f ? 0.5f : -0.5f)));
+	}
+};
+
+// Bounds of every position, per block across the pool and then over the blocks
+void position_bounds(const StagingArray<Position>& pos, ThreadPool& pool, unsigned int threads, float min[3], float max[3])
+{
+	for (int a = 0; a < 3; a++)
+		min[a] = max[a] = 0.0f;
+	if (pos.empty())
+		return;
+
+	size_t blocks = (pos.size() + pack_block_size - 1) / pack_block_size;
+	std::vector<Position> block_min(blocks), block_max(blocks);
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t first = b * pack_block_size;
+		size_t last = first + pack_block_size < pos.size() ? first + pack_block_size : pos.size();
+		Position lo = pos[first], hi = pos[first];
+		for (size_t i = first + 1; i < last; i++)
+		{
+			lo.x = pos[i].x < lo.x ? pos[i].x : lo.x;
+			lo.y = pos[i].y < lo.y ? pos[i].y : lo.y;
+			lo.z = pos[i].z < lo.z ? pos[i].z : lo.z;
+			hi.x = pos[i].x > hi.x ? pos[i].x : hi.x;
+			hi.y = pos[i].y > hi.y ? pos[i].y : hi.y;
+			hi.z = pos[i].z > hi.z ? pos[i].z : hi.z;
+		}
+		block_min[b] = lo;
+		block_max[b] = hi;
+	}, threads);
+
+	Position lo = block_min[0], hi = block_max[0];
+	for (size_t b = 1; b < blocks; b++)
+	{
+		lo.x = block_min[b].x < lo.x ? block_min[b].x : lo.x;
+		lo.y = block_min[b].y < lo.y ? block_min[b].y : lo.y;
+		lo.z = block_min[b].z < lo.z ? block_min[b].z : lo.z;
+		hi.x = block_max[b].x > hi.x ? block_max[b].x : hi.x;
+		hi.y = block_max[b].y > hi.y ? block_max[b].y : hi.y;
+		hi.z = block_max[b].z > hi.z ? block_max[b].z : hi.z;
+	}
+	min[0] = lo.x, min[1] = lo.y, min[2] = lo.z;
+	max[0] = hi.x, max[1] = hi.y, max[2] = hi.z;
+}
+
+unsigned char* pack_vertices(const StagingArray<Position>& pos, const Vertex* vertices, size_t count, const Normal* normals, const UV* uvs, bool has_normal, bool has_uv, NormalPacking packing, ThreadPool& pool, unsigned int threads, Dequantization& dequantization)
+{
+	Dequantization& d = dequantization;
+	d = Dequantization();
+	d.normal_packing = packing;
+
+	// Position, normal and UV one after another, each normal takes 4 bytes so the stride stays a multiple of 4
+	d.position_size = 8;
+	d.normal_size = !has_normal ? 0 : packing == NormalPacking::Octahedral16 ? 4 : 2;
+	d.uv_size = has_uv ? 4 : 0;
+	d.normal_offset = has_normal ? d.position_size : 0;
+	d.uv_offset = has_uv ? d.position_size + (has_normal ? 4 : 0) : 0;
+	d.stride = d.position_size + (has_normal ? 4 : 0) + d.uv_size;
+
+	float max[3], scale[3];
+	position_bounds(pos, pool, threads, d.position_min, max);
+	for (int a = 0; a < 3; a++)
+	{
+		d.position_extent[a] = max[a] - d.position_min[a];
+		scale[a] = d.position_extent[a] > 0.0f ? 1.0f / d.position_extent[a] : 0.0f;
+	}
+
+	unsigned char* out = new unsigned char[count * d.stride];
+	size_t blocks = (count + pack_block_size - 1) / pack_block_size;
+	pool.parallel_for(blocks, [&](size_t b)
+	{
+		size_t last = (b + 1) * pack_block_size < count ? (b + 1) * pack_block_size : count;
+		PackBatch batch;
+		for (size_t first = b * pack_block_size; first < last; first += pack_batch_size)
+		{
+			size_t n = last - first < pack_batch_size ? last - first : pack_batch_size;
+			batch.load_positions(pos.data(), vertices, first, n, d.position_min, scale);
+			if (has_normal)
+				batch.load_normals(normals, vertices, first, n, packing == NormalPacking::Octahedral16 ? 32767.0f : 127.0f);
+			if (has_uv)
+				batch.load_uvs(uvs, vertices, first, n);
+
+			unsigned char* o = out + first * d.stride;
+			for (size_t i = 0; i < n; i++, o += d.stride)
+			{
+				uint16_t position[4] = { batch.px[i], batch.py[i], batch.pz[i], 0 };
+				memcpy(o, position, sizeof(position));
+				if (has_normal && packing == NormalPacking::Octahedral16)
+				{
+					int16_t normal[2] = { batch.ox[i], batch.oy[i] };
+					memcpy(o + d.normal_offset, normal, sizeof(normal));
+				}
+				else if (has_normal)
+				{
+					// Widened to the 4 bytes up to the next attribute, so the padding is always 0
+					int8_t normal[4] = { static_cast<int8_t>(batch.ox[i]), static_cast<int8_t>(batch.oy[i]), 0, 0 };
+					memcpy(o + d.normal_offset, normal, sizeof(normal));
+				}
+				if (has_uv)
+				{
+					uint32_t uv = glm::packHalf2x16(glm::vec2(batch.u[i], batch.v[i]));
+					memcpy(o + d.uv_offset, &uv, sizeof(uv));
+				}
+			}
+		}
+	}, threads);
+	return out;
+}
+
+void unpack_vertex(const Dequantization& dequantization, const unsigned char* vertex, Position& position, Normal& normal, UV& uv)
+{
+	const Dequantization& d = dequantization;
+	uint64_t p;
+	memcpy(&p, vertex + d.position_offset, sizeof(p));
+	glm::vec4 t = glm::unpackUnorm4x16(p);
+	position = { d.position_min[0] + t.x * d.position_extent[0], d.position_min[1] + t.y * d.position_extent[1], d.position_min[2] + t.z * d.position_extent[2] };
+
+	if (d.normal_size)
+	{
+		glm::vec2 o;
+		if (d.normal_packing == NormalPacking::Octahedral16)
+		{
+			uint32_t n;
+			memcpy(&n, vertex + d.normal_offset, sizeof(n));
+			o = glm::unpackSnorm2x16(n);
+		}
+		else
+		{
+			uint16_t n;
+			memcpy(&n, vertex + d.normal_offset, sizeof(n));
+			o = glm::unpackSnorm2x8(n);
+		}
+		// Unfold the lower half before normalizing
+		glm::vec3 n(o.x, o.y, 1.0f - std::fabs(o.x) - std::fabs(o.y));
+		if (n.z < 0.0f)
+		{
+			n.x = (1.0f - std::fabs(o.y)) * (o.x >= 0.0f ? 1.0f : -1.0f);
+			n.y = (1.0f - std::fabs(o.x)) * (o.y >= 0.0f ? 1.0f : -1.0f);
+		}
+		n = glm::normalize(n);
+		normal = { n.x, n.y, n.z };
+	}
+
+	if (d.uv_size)
+	{
+		uint32_t packed;
+		memcpy(&packed, vertex + d.uv_offset, sizeof(packed));
+		glm::vec2 t2 = glm::unpackHalf2x16(packed);
+		uv = { t2.x, t2.y };
+	}
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+#include "objMesh.hpp"
+
+class ThreadPool;
+
+// Encoding of normals in a packed vertex, octahedral with two 16 or two 8 bit snorm components
+enum class NormalPacking { Octahedral16, Octahedral8 };
+
+struct PackOptions
+{
+	NormalPacking normals = NormalPacking::Octahedral16;
+	// Merge equal vertices and return an index buffer like loadIndexedObject
+	bool indexed = false;
+};
+
+// Everything needed to decode a packed vertex buffer
+// Positions are four unorm16 relative to the mesh bounds, the fourth is 0: position = min + unorm * extent
+// Normals are octahedral snorm pairs in 4 bytes, zero padded for 8 bit components, UVs are two half floats
+// An attribute is absent when its size is 0
+struct Dequantization
+{
+	float position_min[3] = {};
+	float position_extent[3] = {};
+	NormalPacking normal_packing = NormalPacking::Octahedral16;
+	unsigned int stride = 0;
+	unsigned int position_offset = 0, normal_offset = 0, uv_offset = 0;
+	unsigned int position_size = 0, normal_size = 0, uv_size = 0;
+};
+
+// Encodes count vertices into a new[] buffer and fills the parameters to decode it
+// Normals are only read when has_normal and UVs only when has_uv is set
+unsigned char* pack_vertices(const StagingArray<Position>& pos,
+							 const Vertex* vertices,
+							 size_t count,
+							 const Normal* normals,
+							 const UV* uvs,
+							 bool has_normal,
+							 bool has_uv,
+							 NormalPacking packing,
+							 ThreadPool& pool,
+							 unsigned int threads,
+							 Dequantization& dequantization);
+
+// Decodes one packed vertex, attributes absent from the buffer are left untouched
+void unpack_vertex(const Dequantization& dequantization, const unsigned char* vertex, Position& position, Normal& normal, UV& uv);
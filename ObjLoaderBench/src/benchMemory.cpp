@@ -0,0 +1,98 @@
+#include "benchMemory.hpp"
+
+#include <chrono>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <psapi.h>
+#else
+#include <unistd.h>
+#endif
+
+size_t current_rss()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS counters{};
+	if (GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)))
+		return counters.WorkingSetSize;
+	return 0;
+#else
+	std::ifstream statm("/proc/self/statm");
+	size_t pages = 0, resident = 0;
+	statm >> pages >> resident;
+	return resident * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+#endif
+}
+
+PeakMemory::PeakMemory() : m_baseline(current_rss()), m_peak(m_baseline)
+{
+	m_sampler = std::thread([this]
+	{
+		while (!m_stop)
+		{
+			size_t rss = current_rss();
+			if (rss > m_peak)
+				m_peak = rss;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	});
+}
+
+size_t PeakMemory::stop()
+{
+	m_stop = true;
+	if (m_sampler.joinable())
+		m_sampler.join();
+	return m_peak > m_baseline ? m_peak - m_baseline : 0;
+}
+
+// Relaxed counters, a load only reads them after its pool threads are done
+std::atomic<size_t> allocation_count{ 0 };
+std::atomic<size_t> allocation_bytes{ 0 };
+
+AllocationCount allocations()
+{
+	return { allocation_count.load(std::memory_order_relaxed), allocation_bytes.load(std::memory_order_relaxed) };
+}
+
+AllocationCount allocations_since(const AllocationCount& start)
+{
+	AllocationCount now = allocations();
+	return { now.count - start.count, now.bytes - start.bytes };
+}
+
+// The nothrow and array forms forward to these two by default
+void* operator new(size_t size)
+{
+	allocation_count.fetch_add(1, std::memory_order_relaxed);
+	allocation_bytes.fetch_add(size, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+		return p;
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	std::free(p);
+}
+
+// Replaced as well, so every deallocation goes through the one above whichever form the compiler picks
+void operator delete(void* p, size_t) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	operator delete(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	operator delete(p);
+}
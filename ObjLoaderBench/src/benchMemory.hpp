@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+
+// Resident memory of the process in bytes
+size_t current_rss();
+
+// Samples the resident set in the background, the OS peak counters cannot be reset between runs
+class PeakMemory
+{
+public:
+	PeakMemory();
+
+	// Peak growth above the resident set at construction
+	size_t stop();
+
+	~PeakMemory() { stop(); }
+
+private:
+	size_t m_baseline;
+	std::atomic<size_t> m_peak;
+	std::atomic<bool> m_stop{ false };
+	std::thread m_sampler;
+};
+
+// Heap allocations of the whole process, counted by the replaced global operator new
+struct AllocationCount
+{
+	size_t count = 0;
+	size_t bytes = 0;
+};
+
+AllocationCount allocations();
+
+// Allocations made since a snapshot, including those of the pool threads
+AllocationCount allocations_since(const AllocationCount& start);
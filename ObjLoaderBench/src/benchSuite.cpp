@@ -0,0 +1,275 @@
+#include "benchSuite.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include "benchMemory.hpp"
+#include "objFileLoader.hpp"
+#include "syntheticCorpus.hpp"
+
+// One load configuration measured on one corpus file
+struct SuiteResult
+{
+	std::string file;
+	CorpusKind kind = CorpusKind::Positions;
+	size_t bytes = 0;
+	std::string config;
+	unsigned int threads = 0;
+	double best_ms = 0.0;
+	unsigned int vertices = 0;
+	// Triangles the faces of the file make, more than vertices / 3 when the load drops corners or faces
+	size_t file_faces = 0;
+	size_t peak_rss = 0;
+	AllocationCount allocated;
+	// Phases the load reports itself, empty when it reports none
+	std::vector<std::pair<std::string, double>> phases;
+};
+
+// The loads a configuration runs
+struct SuiteConfig
+{
+	const char* name;
+	LoadOptions options;
+	bool indexed;
+	// Through streamObject and a sink instead of loadObject
+	bool streamed = false;
+};
+
+// Vertices per batch of the streamed configuration
+const unsigned int stream_batch_size = 1 << 15;
+
+// Time of one load, the output arrays are freed inside so every repeat starts from the same heap
+double run_load(const char* path, const SuiteConfig& config, unsigned int& vertices, LoadStats& stats)
+{
+	unsigned int count = 0, index_count = 0, position_size, normal_size, uv_size;
+	unsigned int* indices = nullptr;
+	if (config.streamed)
+	{
+		// The sink takes every batch as it is, a streamed load reports no statistics
+		auto start = std::chrono::steady_clock::now();
+		streamObject(path, stream_batch_size, [](const VertexBatch&) { return true; }, count, config.options);
+		auto end = std::chrono::steady_clock::now();
+		vertices = count;
+		return std::chrono::duration<double, std::milli>(end - start).count();
+	}
+	auto start = std::chrono::steady_clock::now();
+	float* buffer = config.indexed ? loadIndexedObject(path, count, indices, index_count, position_size, normal_size, uv_size, config.options, &stats)
+								   : loadObject(path, count, position_size, normal_size, uv_size, config.options, nullptr, &stats);
+	auto end = std::chrono::steady_clock::now();
+	delete[] buffer;
+	delete[] indices;
+	vertices = config.indexed ? index_count : count;
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+SuiteResult measure(const std::string& path, CorpusKind kind, const SuiteConfig& config, int repeats)
+{
+	SuiteResult result;
+	result.file = std::filesystem::path(path).filename().string();
+	result.kind = kind;
+	result.bytes = static_cast<size_t>(std::filesystem::file_size(path));
+	result.config = config.name;
+	result.threads = config.options.threads ? config.options.threads : std::thread::hardware_concurrency();
+
+	LoadStats stats;
+	for (int i = 0; i < repeats; i++)
+	{
+		double ms = run_load(path.c_str(), config, result.vertices, stats);
+		if (i == 0 || ms < result.best_ms)
+			result.best_ms = ms;
+	}
+
+	// Memory is measured on a load of its own, the sampler thread would otherwise skew the timings
+	PeakMemory memory;
+	AllocationCount start = allocations();
+	run_load(path.c_str(), config, result.vertices, stats);
+	result.allocated = allocations_since(start);
+	result.peak_rss = memory.stop();
+
+	// Phases of the last load, the getline configuration reads through the same phases as the mapped ones
+	for (unsigned int phase = 0; phase < load_phase_count; phase++)
+		if (stats.wall_ms[phase] > 0.0)
+			result.phases.push_back({ load_phase_name(static_cast<LoadPhase>(phase)), stats.wall_ms[phase] });
+	return result;
+}
+
+// False when the load dropped faces or corners of the file, its faces per second would not compare with the other files
+bool all_faces_loaded(const SuiteResult& r)
+{
+	return r.vertices / 3 == r.file_faces;
+}
+
+// Triangles of a fan over every f line, counted apart from the timed loads
+size_t count_triangles(const std::string& path)
+{
+	std::ifstream file(path);
+	std::string line;
+	size_t triangles = 0;
+	while (std::getline(file, line))
+	{
+		if (line.size() < 2 || line[0] != 'f' || (line[1] != ' ' && line[1] != '\t'))
+			continue;
+		std::istringstream corners(line.substr(2));
+		std::string corner;
+		size_t count = 0;
+		while (corners >> corner)
+			count++;
+		if (count >= 3)
+			triangles += count - 2;
+	}
+	return triangles;
+}
+
+// JSON string with the characters it cannot hold escaped
+std::string json_string(const std::string& s)
+{
+	std::string out = "\"";
+	for (char c : s)
+	{
+		if (c == '"' || c == '\\')
+		{
+			out += '\\';
+			out += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escaped[8];
+			snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		}
+		else
+			out += c;
+	}
+	return out + "\"";
+}
+
+std::string compiler_name()
+{
+#if defined(_MSC_VER)
+	return "MSVC " + std::to_string(_MSC_VER);
+#elif defined(__clang__)
+	return "Clang " __clang_version__;
+#elif defined(__GNUC__)
+	return "GCC " __VERSION__;
+#else
+	return "unknown";
+#endif
+}
+
+bool write_json(const std::string& path, const SuiteOptions& options, const std::vector<SuiteResult>& results)
+{
+	std::ofstream file(path, std::ios::trunc);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR :: Results file \"" << path << "\" could not be created" << std::endl;
+		return false;
+	}
+
+	char timestamp[32];
+	std::time_t now = std::time(nullptr);
+	std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+#ifdef NDEBUG
+	const char* build = "release";
+#else
+	const char* build = "debug";
+#endif
+
+	// Bump the schema whenever a field changes meaning, so old results are not compared against new ones
+	std::ostringstream json;
+	json << "{\n";
+	json << "  \"schema\": 2,\n";
+	json << "  \"timestamp\": " << json_string(timestamp) << ",\n";
+	json << "  \"machine\": { \"hardware_threads\": " << std::thread::hardware_concurrency() << ", \"compiler\": " << json_string(compiler_name())
+		 << ", \"build\": " << json_string(build) << " },\n";
+	json << "  \"options\": { \"repeats\": " << options.repeats << ", \"seed\": " << options.seed << " },\n";
+	json << "  \"results\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const SuiteResult& r = results[i];
+		double seconds = r.best_ms / 1000.0;
+		json << (i ? ",\n" : "\n") << "    { \"file\": " << json_string(r.file) << ", \"kind\": " << json_string(corpus_name(r.kind)) << ", \"bytes\": " << r.bytes
+			 << ", \"config\": " << json_string(r.config) << ", \"threads\": " << r.threads << ", \"best_ms\": " << r.best_ms
+			 << ", \"mb_per_s\": " << (seconds > 0.0 ? r.bytes / (1024.0 * 1024.0) / seconds : 0.0)
+			 << ", \"faces_per_s\": ";
+		// Faces per second only compares between loads that kept every face, quads lose their second triangle until they are triangulated
+		if (all_faces_loaded(r))
+			json << (seconds > 0.0 ? r.vertices / 3 / seconds : 0.0);
+		else
+			json << "null";
+		json << ", \"file_faces\": " << r.file_faces << ", \"loaded_faces\": " << r.vertices / 3 << ", \"vertices\": " << r.vertices
+			 << ", \"peak_rss_bytes\": " << r.peak_rss << ", \"allocations\": " << r.allocated.count << ", \"allocated_bytes\": " << r.allocated.bytes
+			 << ", \"phases_ms\": {";
+		for (size_t p = 0; p < r.phases.size(); p++)
+			json << (p ? ", " : " ") << json_string(r.phases[p].first) << ": " << r.phases[p].second;
+		json << (r.phases.empty() ? "} }" : " } }");
+	}
+	json << "\n  ]\n}\n";
+	file << json.str();
+	return file.good();
+}
+
+int run_suite(const SuiteOptions& options)
+{
+	std::error_code error;
+	std::filesystem::create_directories(options.corpus_dir, error);
+
+	std::vector<SuiteConfig> configs(6);
+	configs[0] = { "mapped_serial", LoadOptions(), false };
+	configs[0].options.threads = 1;
+	configs[1] = { "mapped_parallel", LoadOptions(), false };
+	configs[2] = { "getline", LoadOptions(), false };
+	configs[2].options.memory_map = false;
+	configs[3] = { "indexed", LoadOptions(), true };
+	configs[4] = { "pipelined", LoadOptions(), false };
+	configs[4].options.pipeline = true;
+	configs[5] = { "streamed", LoadOptions(), false, true };
+
+	// Steps of about ten from 1 MB to 10 GB, the large ones only when asked for as they need the disk space and the memory to load them
+	const size_t megabyte = size_t(1) << 20;
+	const size_t sizes[] = { 1, 10, 100, 1024, 10240 };
+
+	std::vector<SuiteResult> results;
+	for (size_t megabytes : sizes)
+	{
+		if (megabytes * megabyte > options.max_bytes)
+			break;
+		for (CorpusKind kind : corpus_kinds)
+		{
+			std::string name = std::string(corpus_name(kind)) + "_" + std::to_string(megabytes) + "mb_seed" + std::to_string(options.seed) + ".obj";
+			std::string path = (std::filesystem::path(options.corpus_dir) / name).string();
+			if (!std::filesystem::exists(path))
+			{
+				CorpusInfo info;
+				std::cout << "generating " << path << std::endl;
+				if (!generate_corpus(path.c_str(), kind, megabytes * megabyte, options.seed, info))
+					return 1;
+			}
+
+			size_t file_faces = count_triangles(path);
+			for (const SuiteConfig& config : configs)
+			{
+				results.push_back(measure(path, kind, config, options.repeats));
+				SuiteResult& r = results.back();
+				r.file_faces = file_faces;
+				double seconds = r.best_ms / 1000.0;
+				std::cout << "  " << name << " " << r.config << " : " << r.best_ms << " ms, " << r.bytes / (1024.0 * 1024.0) / seconds << " MB/s, ";
+				if (all_faces_loaded(r))
+					std::cout << r.vertices / 3 / seconds << " faces/s";
+				else
+					std::cout << r.vertices / 3 << " of " << r.file_faces << " faces loaded";
+				std::cout << ", peak RSS +" << r.peak_rss / (1024.0 * 1024.0) << " MB, " << r.allocated.count << " allocations" << std::endl;
+			}
+		}
+	}
+
+	if (!options.json_path.empty() && !write_json(options.json_path, options, results))
+		return 1;
+	return 0;
+}
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+struct SuiteOptions
+{
+	// Generated files are kept here and reused by later runs with the same seed
+	std::string corpus_dir = "corpus";
+	// Files from 1 MB up to this size in steps of ten, at most 10 GB
+	size_t max_bytes = size_t(100) << 20;
+	int repeats = 3;
+	uint64_t seed = 1;
+	// Results as JSON, empty only prints them
+	std::string json_path;
+};
+
+// Loads every corpus file in each configuration, returns the process exit code
+int run_suite(const SuiteOptions& options);
@@ -0,0 +1,362 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "benchMemory.hpp"
+#include "benchSuite.hpp"
+#include "mappedFile.hpp"
+#include "objFileLoader.hpp"
+#include "objTokenizer.hpp"
+
+// Best wall time in seconds of a number of loads with the given options
+double time_load(const char* path, const LoadOptions& options, int repeats, unsigned int& count)
+{
+	double best = 0.0;
+	for (int i = 0; i < repeats; i++)
+	{
+		unsigned int position_size, normal_size, uv_size;
+		auto start = std::chrono::steady_clock::now();
+		float* buffer = loadObject(path, count, position_size, normal_size, uv_size, options);
+		auto end = std::chrono::steady_clock::now();
+		delete[] buffer;
+
+		double seconds = std::chrono::duration<double>(end - start).count();
+		if (i == 0 || seconds < best)
+			best = seconds;
+	}
+	return best;
+}
+
+// Compares the tokenizer float parser against strtof on every attribute value in the file
+void bench_number_parser(const char* path)
+{
+	MappedFile file(path);
+	if (!file.is_open())
+		return;
+
+	// Collect the number tokens up front so both parsers see the same input
+	std::vector<std::string> numbers;
+	const char* it = file.data();
+	const char* end = it + file.size();
+	while (it != end)
+	{
+		const char* eol = static_cast<const char*>(memchr(it, '\n', end - it));
+		if (!eol)
+			eol = end;
+		Tokenizer tokens(std::string_view(it, eol - it));
+		std::string_view head = tokens.next_token();
+		if (head == "v" || head == "vn" || head == "vt")
+			for (std::string_view token = tokens.next_token(); !token.empty(); token = tokens.next_token())
+				numbers.emplace_back(token);
+		it = eol == end ? end : eol + 1;
+	}
+	if (numbers.empty())
+		return;
+
+	std::vector<float> expected(numbers.size()), parsed(numbers.size());
+	auto start = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numbers.size(); i++)
+		expected[i] = std::strtof(numbers[i].c_str(), nullptr);
+	auto middle = std::chrono::steady_clock::now();
+	for (size_t i = 0; i < numbers.size(); i++)
+	{
+		Tokenizer tokens(numbers[i]);
+		tokens.parse_float(parsed[i]);
+	}
+	auto end_time = std::chrono::steady_clock::now();
+
+	size_t mismatches = 0;
+	for (size_t i = 0; i < numbers.size(); i++)
+		mismatches += memcmp(&expected[i], &parsed[i], sizeof(float)) != 0;
+
+	double strtof_ns = std::chrono::duration<double, std::nano>(middle - start).count() / numbers.size();
+	double tokenizer_ns = std::chrono::duration<double, std::nano>(end_time - middle).count() / numbers.size();
+	std::cout << "  floats : " << numbers.size() << " values, strtof " << strtof_ns << " ns, tokenizer " << tokenizer_ns
+			  << " ns (" << strtof_ns / tokenizer_ns << "x), " << mismatches << " mismatches" << std::endl;
+}
+
+// Options of the suite mode, false on an unknown or incomplete argument
+bool parse_suite_options(int argc, char** argv, SuiteOptions& options)
+{
+	for (int i = 2; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (i + 1 >= argc)
+			return false;
+		if (argument == "--max-mb")
+			options.max_bytes = static_cast<size_t>(std::strtoull(argv[++i], nullptr, 10)) << 20;
+		else if (argument == "--repeats")
+			options.repeats = std::max(1, std::atoi(argv[++i]));
+		else if (argument == "--seed")
+			options.seed = std::strtoull(argv[++i], nullptr, 10);
+		else if (argument == "--json")
+			options.json_path = argv[++i];
+		else if (argument == "--corpus")
+			options.corpus_dir = argv[++i];
+		else
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	if (argc < 2)
+	{
+		std::cout << "usage: ObjLoaderBench <file.obj> [repeats] [trace.json]" << std::endl;
+		std::cout << "       ObjLoaderBench --suite [--corpus dir] [--max-mb size] [--repeats count] [--seed seed] [--json results.json]" << std::endl;
+		return 1;
+	}
+	if (std::strcmp(argv[1], "--suite") == 0)
+	{
+		SuiteOptions options;
+		if (!parse_suite_options(argc, argv, options))
+		{
+			std::cout << "ERROR :: Invalid suite arguments" << std::endl;
+			return 1;
+		}
+		return run_suite(options);
+	}
+	const char* path = argv[1];
+	int repeats = argc > 2 ? std::atoi(argv[2]) : 5;
+	if (repeats < 1)
+		repeats = 1;
+
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		std::cout << "ERROR :: File \"" << path << "\" NOT FOUND or NO ACCESS" << std::endl;
+		return 1;
+	}
+	double megabytes = static_cast<double>(file.tellg()) / (1024.0 * 1024.0);
+	file.close();
+
+	LoadOptions stream;
+	stream.memory_map = false;
+	LoadOptions mapped;
+	mapped.memory_map = true;
+	mapped.threads = 1;
+
+	unsigned int stream_count = 0, mapped_count = 0;
+	double stream_time = time_load(path, stream, repeats, stream_count);
+	double mapped_time = time_load(path, mapped, repeats, mapped_count);
+
+	std::cout << path << " (" << megabytes << " MB, best of " << repeats << ")" << std::endl;
+	std::cout << "  stream : " << stream_time * 1000.0 << " ms, " << megabytes / stream_time << " MB/s, " << stream_count << " vertices" << std::endl;
+	std::cout << "  mapped : " << mapped_time * 1000.0 << " ms, " << megabytes / mapped_time << " MB/s, " << mapped_count << " vertices" << std::endl;
+	if (stream_count != mapped_count)
+		std::cout << "WARNING :: vertex count differs between modes" << std::endl;
+
+	// Block reads in flight while the pool parses, only faster than mapping when the file is not cached
+	{
+		LoadOptions pipelined;
+		pipelined.pipeline = true;
+		unsigned int pipelined_count = 0;
+		double pipelined_time = time_load(path, pipelined, repeats, pipelined_count);
+		std::cout << "  pipelined : " << pipelined_time * 1000.0 << " ms, " << megabytes / pipelined_time << " MB/s" << std::endl;
+		if (pipelined_count != mapped_count)
+			std::cout << "WARNING :: vertex count differs between modes" << std::endl;
+	}
+
+	// Parallel scaling of the mapped path against its serial run
+	unsigned int hardware = std::thread::hardware_concurrency();
+	for (unsigned int threads = 2; threads <= hardware; threads *= 2)
+	{
+		LoadOptions parallel = mapped;
+		parallel.threads = threads;
+		unsigned int parallel_count = 0;
+		double parallel_time = time_load(path, parallel, repeats, parallel_count);
+		std::cout << "  " << threads << " threads : " << parallel_time * 1000.0 << " ms, " << megabytes / parallel_time << " MB/s, "
+				  << mapped_time / parallel_time << "x" << std::endl;
+		if (parallel_count != mapped_count)
+			std::cout << "WARNING :: vertex count differs from the serial path" << std::endl;
+	}
+
+	// Exact pre-sizing against growing the staging arrays, one load each so the peaks are comparable
+	for (bool prepass : { false, true })
+	{
+		LoadOptions options;
+		options.prepass = prepass;
+		unsigned int count, position_size, normal_size, uv_size;
+		PeakMemory memory;
+		auto start = std::chrono::steady_clock::now();
+		float* buffer = loadObject(path, count, position_size, normal_size, uv_size, options);
+		auto end = std::chrono::steady_clock::now();
+		size_t peak = memory.stop();
+		delete[] buffer;
+		std::cout << "  " << (prepass ? "prepass" : "growing") << " : " << std::chrono::duration<double, std::milli>(end - start).count() << " ms, peak RSS +"
+				  << peak / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+
+	// Streamed batches against the single output array, the sink only touches the data like an upload would
+	{
+		unsigned int count = 0;
+		double checksum = 0.0;
+		PeakMemory memory;
+		auto start = std::chrono::steady_clock::now();
+		streamObject(path, 3 << 16, [&](const VertexBatch& batch)
+		{
+			checksum += batch.vertices[0];
+			return true;
+		}, count);
+		auto end = std::chrono::steady_clock::now();
+		size_t peak = memory.stop();
+		std::cout << "  streamed : " << std::chrono::duration<double, std::milli>(end - start).count() << " ms, peak RSS +"
+				  << peak / (1024.0 * 1024.0) << " MB, " << count << " vertices" << std::endl;
+	}
+
+	// Normal generation modes, only differ for files without normals, and the tangent stage on top
+	{
+		const char* names[] = { "flat", "area", "angle" };
+		NormalMode modes[] = { NormalMode::Flat, NormalMode::Area, NormalMode::Angle };
+		for (int m = 0; m < 3; m++)
+		{
+			LoadOptions options;
+			options.normals = modes[m];
+			unsigned int count = 0;
+			double seconds = time_load(path, options, repeats, count);
+			std::cout << "  normals " << names[m] << " : " << seconds * 1000.0 << " ms" << std::endl;
+		}
+
+		LoadOptions options;
+		options.format = VertexFormat::PositionNormalUVTangent;
+		unsigned int count = 0;
+		double seconds = time_load(path, options, repeats, count);
+		std::cout << "  tangents : " << seconds * 1000.0 << " ms" << std::endl;
+	}
+
+	// Indexed output against the unrolled vertex count
+	{
+		unsigned int count, index_count, position_size, normal_size, uv_size;
+		unsigned int* indices = nullptr;
+		LoadStats stats;
+		auto start = std::chrono::steady_clock::now();
+		float* buffer = loadIndexedObject(path, count, indices, index_count, position_size, normal_size, uv_size, {}, &stats);
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "  indexed : " << std::chrono::duration<double, std::milli>(end - start).count() << " ms, " << count << " unique of "
+				  << index_count << " vertices, ratio " << stats.dedup_ratio << ", dedup " << stats.dedup_ms << " ms" << std::endl;
+		delete[] buffer;
+		delete[] indices;
+	}
+
+	// Material ranges, the faces sorted by usemtl against the file order
+	{
+		LoadOptions unsorted;
+		unsorted.materials = false;
+		unsigned int count = 0;
+		double unsorted_time = time_load(path, unsorted, repeats, count);
+
+		unsigned int position_size, normal_size, uv_size;
+		MeshParts parts;
+		auto start = std::chrono::steady_clock::now();
+		float* buffer = loadObject(path, count, position_size, normal_size, uv_size, {}, &parts);
+		auto end = std::chrono::steady_clock::now();
+		delete[] buffer;
+		std::cout << "  materials : " << std::chrono::duration<double, std::milli>(end - start).count() << " ms sorted, " << unsorted_time * 1000.0 << " ms in file order, "
+				  << parts.materials.size() << " materials, " << parts.material_ranges.size() << " ranges" << std::endl;
+	}
+
+	// Index buffer optimization, simulated cache efficiency of the file order against the optimized one
+	// Smooth normals, flat generated ones would leave no vertex shared between faces
+	for (MeshOptimization optimize : { MeshOptimization::VertexCache, MeshOptimization::Overdraw })
+	{
+		unsigned int count, index_count, position_size, normal_size, uv_size;
+		unsigned int* indices = nullptr;
+		LoadOptions options;
+		options.normals = NormalMode::Area;
+		options.optimize = optimize;
+		LoadStats stats;
+		float* buffer = loadIndexedObject(path, count, indices, index_count, position_size, normal_size, uv_size, options, &stats);
+		std::cout << "  optimize " << (optimize == MeshOptimization::VertexCache ? "vcache" : "overdraw") << " : " << stats.optimize_ms << " ms, ACMR "
+				  << stats.cache_before.acmr << " -> " << stats.cache_after.acmr << ", ATVR " << stats.cache_before.atvr << " -> " << stats.cache_after.atvr << std::endl;
+		delete[] buffer;
+		delete[] indices;
+	}
+
+	// Meshlets for the mesh shading path, against the indexed load of the same vertices
+	{
+		unsigned int count, position_size, normal_size, uv_size;
+		Meshlets meshlets;
+		LoadOptions options;
+		options.normals = NormalMode::Area;
+		auto start = std::chrono::steady_clock::now();
+		float* buffer = loadMeshletObject(path, count, position_size, normal_size, uv_size, meshlets, {}, options);
+		auto end = std::chrono::steady_clock::now();
+		size_t triangles = 0, culled = 0;
+		for (const Meshlet& meshlet : meshlets.meshlets)
+			triangles += meshlet.triangle_count;
+		for (const MeshletBounds& bounds : meshlets.bounds)
+			culled += bounds.cone_cutoff < 1.0f;
+		std::cout << "  meshlets : " << std::chrono::duration<double, std::milli>(end - start).count() << " ms, " << meshlets.meshlets.size() << " meshlets, "
+				  << (meshlets.meshlets.empty() ? 0.0 : static_cast<double>(meshlets.vertices.size()) / meshlets.meshlets.size()) << " vertices and "
+				  << (meshlets.meshlets.empty() ? 0.0 : static_cast<double>(triangles) / meshlets.meshlets.size()) << " triangles each, "
+				  << culled << " with a normal cone" << std::endl;
+		delete[] buffer;
+	}
+
+	// Packed output against the float vertices of the same load
+	for (NormalPacking packing : { NormalPacking::Octahedral16, NormalPacking::Octahedral8 })
+	{
+		unsigned int count, index_count;
+		unsigned int* indices = nullptr;
+		Dequantization dequantization;
+		PackOptions pack;
+		pack.normals = packing;
+		auto start = std::chrono::steady_clock::now();
+		unsigned char* buffer = loadPackedObject(path, count, indices, index_count, dequantization, pack);
+		auto end = std::chrono::steady_clock::now();
+		std::cout << "  packed " << (packing == NormalPacking::Octahedral16 ? "oct16" : "oct8") << " : " << std::chrono::duration<double, std::milli>(end - start).count()
+				  << " ms, " << dequantization.stride << " bytes per vertex, " << count * static_cast<double>(dequantization.stride) / (1024.0 * 1024.0) << " MB" << std::endl;
+		delete[] buffer;
+	}
+
+	// Startup with a binary cache, the cold load parses and writes it, warm loads map it
+	{
+		std::string cache_path = std::string(path) + ".cache";
+		std::remove(cache_path.c_str());
+		LoadOptions options;
+		options.cache_path = cache_path.c_str();
+		unsigned int cold_count = 0, warm_count = 0;
+		double cold_time = time_load(path, options, 1, cold_count);
+		double warm_time = time_load(path, options, repeats, warm_count);
+		std::cout << "  cache cold : " << cold_time * 1000.0 << " ms, warm : " << warm_time * 1000.0 << " ms, " << cold_time / warm_time << "x" << std::endl;
+		if (cold_count != warm_count)
+			std::cout << "WARNING :: vertex count differs between cold and warm loads" << std::endl;
+		std::remove(cache_path.c_str());
+	}
+
+	// Where the time of one default load goes, written as a trace when a path is given
+	{
+		unsigned int count, position_size, normal_size, uv_size;
+		LoadStats stats;
+		float* buffer = loadObject(path, count, position_size, normal_size, uv_size, {}, nullptr, &stats);
+		delete[] buffer;
+		std::cout << "  phases :";
+		for (unsigned int phase = 0; phase < load_phase_count; phase++)
+			if (stats.wall_ms[phase] > 0.0)
+				std::cout << " " << load_phase_name(static_cast<LoadPhase>(phase)) << " " << stats.wall_ms[phase] << " ms";
+		std::cout << ", total " << stats.total_ms << " ms" << std::endl;
+		std::cout << "  lines : " << stats.lines << ", " << stats.skipped_lines << " skipped, " << stats.malformed_lines << " malformed, "
+				  << stats.dropped_faces << " faces dropped, " << stats.allocations << " allocations, peak staging "
+				  << stats.peak_staging_bytes / (1024.0 * 1024.0) << " MB" << std::endl;
+		// Throughput of each stage of a compressed file, they run at the same time so the slower one bounds the load
+		double decompress_ms = stats.wall_ms[static_cast<unsigned int>(LoadPhase::Decompress)];
+		double parse_ms = stats.wall_ms[static_cast<unsigned int>(LoadPhase::Parse)];
+		if (stats.compressed_bytes && decompress_ms > 0.0 && parse_ms > 0.0)
+			std::cout << "  compressed : " << stats.compressed_bytes / (1024.0 * 1024.0) << " MB to " << stats.bytes / (1024.0 * 1024.0) << " MB, decompress "
+					  << stats.bytes / (1024.0 * 1024.0) / (decompress_ms / 1000.0) << " MB/s, parse " << stats.bytes / (1024.0 * 1024.0) / (parse_ms / 1000.0) << " MB/s" << std::endl;
+		if (argc > 3 && write_load_trace(stats, argv[3]))
+			std::cout << "  trace : " << argv[3] << std::endl;
+	}
+
+	bench_number_parser(path);
+
+	return 0;
+}
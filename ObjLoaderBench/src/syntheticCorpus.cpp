@@ -0,0 +1,233 @@
+#include "syntheticCorpus.hpp"
+
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+
+const char* corpus_name(CorpusKind kind)
+{
+	switch (kind)
+	{
+	case CorpusKind::Positions:			return "positions";
+	case CorpusKind::PositionUV:		return "position_uv";
+	case CorpusKind::PositionUVNormal:	return "position_uv_normal";
+	case CorpusKind::Quads:				return "quads";
+	case CorpusKind::Comments:			return "comments";
+	default:							return "mixed";
+	}
+}
+
+// SplitMix64, the same on every platform unlike the distributions of <random>
+uint64_t next_random(uint64_t& state)
+{
+	uint64_t z = (state += 0x9E3779B97F4A7C15ull);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+	return z ^ (z >> 31);
+}
+
+// Uniform in [0, range)
+int64_t random_below(uint64_t& state, int64_t range)
+{
+	return static_cast<int64_t>(next_random(state) % static_cast<uint64_t>(range));
+}
+
+// Buffered text output, values are integer counts of millionths formatted by hand
+// so the bytes never depend on the compiler, the C library or the locale
+class CorpusWriter
+{
+public:
+	explicit CorpusWriter(const std::string& path) : m_file(path, std::ios::binary | std::ios::trunc) {}
+
+	bool is_open() const { return m_file.is_open(); }
+	size_t written() const { return m_written + m_buffer.size(); }
+
+	void text(std::string_view s)
+	{
+		m_buffer.append(s);
+		if (m_buffer.size() >= 1 << 20)
+			flush();
+	}
+
+	// Written with six decimals like %f
+	void number(int64_t millionths)
+	{
+		char digits[24];
+		uint64_t magnitude = millionths < 0 ? 0 - static_cast<uint64_t>(millionths) : static_cast<uint64_t>(millionths);
+		auto result = std::to_chars(digits, digits + sizeof(digits), magnitude / 1000000);
+		m_buffer.append(millionths < 0 ? " -" : " ");
+		m_buffer.append(digits, result.ptr);
+		uint64_t fraction = magnitude % 1000000;
+		char decimals[7] = { '.' };
+		for (int i = 6; i > 0; i--, fraction /= 10)
+			decimals[i] = static_cast<char>('0' + fraction % 10);
+		m_buffer.append(decimals, sizeof(decimals));
+	}
+
+	// One face corner, the same index for every attribute the corner has
+	void corner(size_t index, bool uv, bool normal)
+	{
+		char digits[24];
+		auto result = std::to_chars(digits, digits + sizeof(digits), index);
+		std::string_view value(digits, result.ptr - digits);
+		m_buffer.push_back(' ');
+		m_buffer.append(value);
+		if (!uv && !normal)
+			return;
+		m_buffer.push_back('/');
+		if (uv)
+			m_buffer.append(value);
+		if (!normal)
+			return;
+		m_buffer.push_back('/');
+		m_buffer.append(value);
+	}
+
+	bool flush()
+	{
+		m_file.write(m_buffer.data(), m_buffer.size());
+		m_written += m_buffer.size();
+		m_buffer.clear();
+		return m_file.good();
+	}
+
+private:
+	std::ofstream m_file;
+	std::string m_buffer;
+	size_t m_written = 0;
+};
+
+// Vertices per side of a patch, every patch is a jittered height field over its own square
+const int64_t patch_side = 32;
+const int64_t unit = 1000000;
+
+// Triangle wave of period and amplitude one unit
+int64_t wave(int64_t x)
+{
+	int64_t t = ((x % unit) + unit) % unit;
+	return t < unit / 2 ? 2 * t - unit / 2 : 3 * unit / 2 - 2 * t;
+}
+
+void write_patch(CorpusWriter& out, CorpusKind kind, size_t patch, uint64_t& random, CorpusInfo& info)
+{
+	bool has_uv = kind != CorpusKind::Positions && kind != CorpusKind::Comments;
+	bool has_normal = kind != CorpusKind::Positions && kind != CorpusKind::PositionUV;
+	bool comments = kind == CorpusKind::Comments || kind == CorpusKind::Mixed;
+	size_t base = info.positions + 1;
+	int64_t origin_x = static_cast<int64_t>(patch % 64) * 10 * unit;
+	int64_t origin_z = static_cast<int64_t>(patch / 64) * 10 * unit;
+
+	if (comments)
+	{
+		out.text("\n# ------------------------------------------------------------\n");
+		out.text("# Patch " + std::to_string(patch) + ", " + std::to_string(patch_side * patch_side) + " vertices\n");
+		out.text("# ------------------------------------------------------------\n\n");
+	}
+	if (kind == CorpusKind::Mixed)
+		out.text("o patch_" + std::to_string(patch) + "\n");
+
+	for (int64_t j = 0; j < patch_side; j++)
+		for (int64_t i = 0; i < patch_side; i++)
+		{
+			if (kind == CorpusKind::Comments && i == 0)
+				out.text("# row " + std::to_string(j) + "\n");
+			int64_t x = origin_x + i * unit * 3 / 10 + random_below(random, unit / 20);
+			int64_t z = origin_z + j * unit * 3 / 10 + random_below(random, unit / 20);
+			int64_t y = wave(x / 7) + wave(z / 5) / 2 + random_below(random, unit / 100);
+			out.text("v");
+			out.number(x);
+			out.number(y);
+			out.number(z);
+			out.text("\n");
+		}
+	if (has_uv)
+		for (int64_t j = 0; j < patch_side; j++)
+			for (int64_t i = 0; i < patch_side; i++)
+			{
+				out.text("vt");
+				out.number(i * unit / (patch_side - 1));
+				out.number(j * unit / (patch_side - 1));
+				out.text("\n");
+			}
+	if (has_normal)
+		for (int64_t n = 0; n < patch_side * patch_side; n++)
+		{
+			// The squared length is exact and a correctly rounded square root, so the unit normal is the same everywhere
+			int64_t nx = random_below(random, unit) - unit / 2, nz = random_below(random, unit) - unit / 2;
+			double length = std::sqrt(static_cast<double>(nx * nx + unit * unit + nz * nz));
+			out.text("vn");
+			out.number(std::llround(static_cast<double>(nx * unit) / length));
+			out.number(std::llround(static_cast<double>(unit * unit) / length));
+			out.number(std::llround(static_cast<double>(nz * unit) / length));
+			out.text("\n");
+		}
+	info.positions += static_cast<size_t>(patch_side * patch_side);
+
+	// Two triangles or one quad per cell, the mixed kind picks per cell and starts a group every few rows
+	for (int64_t j = 0; j + 1 < patch_side; j++)
+	{
+		if (kind == CorpusKind::Mixed && j % 8 == 0)
+		{
+			size_t group = static_cast<size_t>(j / 8);
+			out.text("g part_" + std::to_string(group) + "\nusemtl material_" + std::to_string((patch + group) % 4) + "\n");
+			out.text(group % 2 ? "s off\n" : "s 1\n");
+		}
+		for (int64_t i = 0; i + 1 < patch_side; i++)
+		{
+			size_t a = base + static_cast<size_t>(j * patch_side + i), b = a + 1, c = a + patch_side, d = c + 1;
+			bool quad = kind == CorpusKind::Quads || (kind == CorpusKind::Mixed && (next_random(random) & 1));
+			if (quad)
+			{
+				out.text("f");
+				for (size_t corner : { a, b, d, c })
+					out.corner(corner, has_uv, has_normal);
+				out.text("\n");
+				info.faces++;
+				continue;
+			}
+			for (size_t triangle = 0; triangle < 2; triangle++)
+			{
+				out.text("f");
+				for (size_t corner : { a, triangle ? d : b, triangle ? c : d })
+					out.corner(corner, has_uv, has_normal);
+				out.text("\n");
+				info.faces++;
+			}
+		}
+	}
+}
+
+bool generate_corpus(const char* path, CorpusKind kind, size_t bytes, uint64_t seed, CorpusInfo& info)
+{
+	info = CorpusInfo();
+	std::string temporary = std::string(path) + ".tmp";
+	bool written;
+	{
+		CorpusWriter out(temporary);
+		if (!out.is_open())
+		{
+			std::cout << "ERROR :: Corpus file \"" << temporary << "\" could not be created" << std::endl;
+			return false;
+		}
+
+		uint64_t random = seed;
+		out.text(std::string("# Synthetic ") + corpus_name(kind) + " corpus, seed " + std::to_string(seed) + "\n");
+		for (size_t patch = 0; out.written() < bytes; patch++)
+			write_patch(out, kind, patch, random, info);
+		written = out.flush();
+		info.bytes = out.written();
+	}
+
+	std::remove(path);
+	if (!written || std::rename(temporary.c_str(), path) != 0)
+	{
+		std::remove(temporary.c_str());
+		std::cout << "ERROR :: Corpus file \"" << path << "\" could not be written" << std::endl;
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Line mixes of the synthetic files, each models the output of a kind of exporter
+enum class CorpusKind
+{
+	Positions,			// v and f p
+	PositionUV,			// v, vt and f p/t
+	PositionUVNormal,	// v, vt, vn and f p/t/n
+	Quads,				// Same attributes with four corners per face
+	Comments,			// v, vn and f p//n between comment blocks and blank lines
+	Mixed				// Objects, groups, materials and smoothing groups with triangles and quads
+};
+
+const CorpusKind corpus_kinds[] = { CorpusKind::Positions, CorpusKind::PositionUV, CorpusKind::PositionUVNormal, CorpusKind::Quads, CorpusKind::Comments, CorpusKind::Mixed };
+
+const char* corpus_name(CorpusKind kind);
+
+// What a generated file holds, faces counts the f lines whatever their corner count
+struct CorpusInfo
+{
+	size_t bytes = 0;
+	size_t positions = 0;
+	size_t faces = 0;
+};
+
+// Writes a file of at least bytes bytes built from grid patches, the same kind, size and seed always give the same file
+// The file is written next to path and renamed when complete, so an interrupted run never leaves a short corpus behind
+bool generate_corpus(const char* path, CorpusKind kind, size_t bytes, uint64_t seed, CorpusInfo& info);